@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BITS_H
+#define BITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* LSB first bit streams for the codecs, at most 32 bits per call */
+
+/* bit writer */
+
+struct bw {
+	uint8_t *p, *end;
+	uint64_t acc;
+	int n;
+	int full;
+};
+
+static inline void bw_put(struct bw *w, uint32_t v, int bits) {
+	w->acc |= (uint64_t)v << w->n;
+	w->n += bits;
+	if (w->n >= 32) {
+		if (w->end - w->p < 4)
+			w->full = 1;
+		else {
+			uint32_t out = w->acc;
+			memcpy(w->p, &out, 4);
+			w->p += 4;
+		}
+		w->acc >>= 32;
+		w->n -= 32;
+	}
+}
+
+static inline size_t bw_finish(struct bw *w, uint8_t *start) {
+	for (; w->n > 0; w->n -= 8, w->acc >>= 8) {
+		if (w->p == w->end)
+			return 0;
+		*w->p++ = w->acc;
+	}
+	return w->full ? 0 : (size_t)(w->p - start);
+}
+
+/* bit reader, reads zeros past the end */
+
+struct br {
+	const uint8_t *p, *end;
+	uint64_t acc;
+	int n;
+};
+
+static inline void br_fill(struct br *r) {
+	if (r->n > 56)
+		return;
+	if (r->end - r->p >= 8) {
+		// top up to 56..63 bits with one load
+		uint64_t v;
+		memcpy(&v, r->p, 8);
+		r->acc |= v << r->n;
+		r->p += (63 - r->n) >> 3;
+		r->n |= 56;
+		return;
+	}
+	for (; r->n <= 56; r->p++, r->n += 8)
+		r->acc |= (uint64_t)((r->p < r->end) ? *r->p : 0) << r->n;
+}
+
+static inline uint32_t br_get(struct br *r, int bits) {
+	br_fill(r);
+	uint32_t v = r->acc & ((1ULL << bits) - 1);
+	r->acc >>= bits;
+	r->n -= bits;
+	return v;
+}
+
+/* no bits were taken from past the end */
+static inline int br_ok(const struct br *r) {
+	return (r->p - r->end) * 8 <= r->n;
+}
+
+#endif
@@ -15,20 +15,39 @@
  * along with this code.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
 #include <libbladeRF.h>
 #include <sys/mman.h>
 #include <linux/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <signal.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
+
+#include "storage.h"
+#include "pipeline.h"
+#include "trigger.h"
+#include "pack12.h"
+#include "iqz.h"
+#include "ddc.h"
+#include "resamp.h"
+#include "pfb.h"
+#include "ols.h"
+#include "spectro.h"
+#include "pyramid.h"
+#include "tap.h"
 
 #ifndef MIN
 #define MIN(a,b)    ((a)<=(b)?(a):(b))
@@ -36,10 +55,9 @@
 
 #define DEFAULT_FREQ         866450000  // 866.45 MHz
 #define DEFAULT_SAMPLERATE   8000000    // 8 MS/s
-#define DEFAULT_BANDWIDTH   (7000000)
+#define MAX_SAMPLERATE      61440000    // above this, bladeRF 2.0 needs oversampling and SC8
 #define NUM_BUFFERS         64
 #define NUM_SAMPLES			(127*2048)
-#define BUFFER_SIZE  		(NUM_SAMPLES * sizeof(uint16_t) * 2)
 #define NUM_TRANSFERS       16
 #define TIMEOUT_MS			3500
 
@@ -50,56 +68,70 @@ static void handle_signal(int sig) {
     stop_flag = 1;
 }
 
-struct mf {
-	int fd;
-	void *map_base;
-	size_t map_size;
-};
-
-static void close_file(struct mf *mf, size_t written) {
-	assert(mf->fd >= 0);
-	assert(mf->map_base && (mf->map_base != MAP_FAILED));
-    // Truncate file to actual written data
-    if (written > 0) {
-        if (msync(mf->map_base, written, MS_SYNC) != 0)
-            perror("msync");
-    }
-	if (ftruncate(mf->fd, written) != 0)
-		perror("ftruncate (final)");
-	munmap(mf->map_base, mf->map_size);
-	close(mf->fd);
-}
-
-static int create_file(struct mf *mf, const char *fn, size_t max_size) {
-	memset(mf, 0, sizeof(struct mf));
-	mf->fd = -1;
-
-	// File create + mmap
-    int fd = open(fn, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP);
-    if (fd < 0) {
-        perror("open");
-        return fd;
-    }
-    if (ftruncate(fd, max_size) != 0) {
-        perror("ftruncate");
-        close(fd);
-        return -1;
-    }
-    void *map_base = mmap(NULL, max_size, PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
-    if (map_base == MAP_FAILED) {
-        perror("mmap");
-        close(fd);
-        return -1;
-    }
-    mf->fd = fd;
-    mf->map_base = map_base;
-    mf->map_size = max_size;
-	return 0;
-}
-
 static void usage(const char *argv0) {
-    fprintf(stderr, "Usage: %s -f <filename> -s <max_filesize>M/G/T [-g <manual_gain>] [-l <logfile>]\n", argv0);
+    fprintf(stderr, "Usage: %s -f <filename> -s <max_filesize>M/G/T [-g <manual_gain>] [-l <logfile>] [-o mmap|uring] [-p <buffers>] [-a] [-z] [-w] [-m] [-T <seconds>] [-e <dBFS>] [-c <fifo>] [-S <segment_size>] [-t <seconds>] [-d <dirty_max>] [-P <prefault>] [-H] [-F sc16|sc8|packed12] [-C <codec>[:<level>]] [-D <offset>:<rate>[:<passband>[:<dB>]]] [-R <rate>[:<passband>[:<dB>]]] [-K <channels>[:<list>]] [-O] [-X <offset>:<bandwidth>[:<rate>][,...]] [-W <fft>[:<seconds>]] [-A <bands>] [-M <samples>] [-Q <dBFS>[:<hyst dB>[:<pre s>[:<post s>]]]] [-j <threads>] [-r <samplerate>] [-b]\n", argv0);
     fputs("          (filesize multiplier: M, G or T for Mega-/Giga-/Terabytes)\n", stderr);
+    fprintf(stderr, "   -f: repeat to stripe the capture across up to %d files/disks (layout in <first file>.stripe)\n", STRIPE_MAX);
+    fputs("   -o: storage backend, mmap (default) or io_uring with O_DIRECT\n", stderr);
+    fputs("   -p: receive into a pool of <buffers> RAM buffers drained by a writer thread\n", stderr);
+    fprintf(stderr, "   -a: capture through the async stream API, saves the sync API's copy (implies -p, default %d buffers)\n", NUM_BUFFERS);
+    fputs("   -z: zero-fill samples lost to overruns instead of skipping them (gaps go to <filename>.gaps)\n", stderr);
+    fputs("   -w: ring mode, the file wraps around and keeps the last <max_filesize> of samples\n", stderr);
+    fputs("   -m: RAM ring, keeps the last <max_filesize> of samples in (huge page) memory and dumps 7/8 of it\n", stderr);
+    fputs("       plus -T seconds after each trigger to a new file (the filename is a pattern like ev%d.iq),\n", stderr);
+    fputs("       rearms and goes on, dumps are listed in <filename>.events\n", stderr);
+    fputs("   -T: stop this many seconds after the trigger (SIGUSR1, -e, -c) fired, with -m dump as long after it, default 0\n", stderr);
+    fputs("   -e: trigger when the power of a 2048 sample window exceeds <dBFS>\n", stderr);
+    fputs("   -c: control FIFO, accepts \"trigger\" and \"stop\"\n", stderr);
+    fputs("   -S: start a new file every <segment_size> bytes (M/G/T), filename is a pattern like capture_%05d.iq\n", stderr);
+    fputs("   -t: start a new file every <seconds>, can be combined with -S\n", stderr);
+    fputs("   -d: mmap backend, max. unwritten data in the page cache (bytes or M/G), default 256M, 0 = up to the kernel\n", stderr);
+    fputs("   -P: mmap backend, fault in this much (bytes or M/G) ahead of the write position, default 64M, 0 = off\n", stderr);
+    fputs("   -H: hugepages for the -p buffer pool, io_uring and stripe buffers and for tmpfs targets (hugetlbfs is always fine)\n", stderr);
+    fputs("   -F: sample format, sc16 (default, 4 bytes/sample), sc8 (2 bytes/sample)\n", stderr);
+    fputs("       or packed12 (sc16 stored as 3 bytes/sample, packed on the writer thread, implies -p)\n", stderr);
+    fprintf(stderr, "   -C: compress into a block indexed container (%s), -s counts uncompressed bytes\n", codec_names());
+    fputs("       lpc: lossless linear prediction and Rice coding for sc16, level = max. predictor order (1-12, default 8)\n", stderr);
+    fputs("       quant: near-lossless sc16, drops bits below level %% (default 10) of the noise floor, best with -g\n", stderr);
+    fputs("   -D: downconvert, only store the channel at <offset> Hz (k/M, may be negative) resampled to <rate>\n", stderr);
+    fputs("       (sample rate / integer) as sc16, passband fraction of <rate> default 0.8, stopband default 80 dB,\n", stderr);
+    fputs("       -s counts stored bytes, filter details go to <filename>.ddc\n", stderr);
+    fputs("   -R: resample to any <rate> (k/M) with a rational polyphase filter, after -D if given, as sc16,\n", stderr);
+    fputs("       passband fraction of the lower rate default 0.8, stopband default 80 dB, -s counts stored bytes,\n", stderr);
+    fputs("       filter details go to <filename>.resamp\n", stderr);
+    fputs("   -K: split the band into <channels> (power of 2) with a polyphase filterbank, store each channel listed\n", stderr);
+    fputs("       (like -3,0,5..9, default all) as sc16 in its own file, the filename is a pattern like ch%d.iq,\n", stderr);
+    fputs("       -s counts bytes per channel, layout in <filename>.channels\n", stderr);
+    fputs("   -O: -K outputs at twice the channel spacing, so channel edges don't alias\n", stderr);
+    fputs("   -X: cut the listed channels out with one shared overlap-save FFT, each as sc16 in its own file\n", stderr);
+    fputs("       (numbered from 0, the filename is a pattern like ch%d.iq) at <rate> (sample rate / power of 2,\n", stderr);
+    fputs("       default the lowest one at least 1.25 * <bandwidth>), -s counts bytes per channel,\n", stderr);
+    fputs("       layout in <filename>.channels\n", stderr);
+    fprintf(stderr, "   -W: spectrogram of the received band to <filename>.spec, <fft> point (power of 2, %d-%d),\n", SPEC_MIN_FFT, SPEC_MAX_FFT);
+    fputs("       mean and peak over <seconds> (default 0.1) per row, on its own thread (see iqtool waterfall)\n", stderr);
+    fprintf(stderr, "   -A: activity index of <bands> (power of 2, up to %d) sub-bands per -W row to <filename>.act,\n", ACT_MAX_BANDS);
+    fputs("       level, peak and occupancy, without -W on 1024 point FFTs per 0.1 s (see iqtool query)\n", stderr);
+    fputs("   -M: min/max/RMS magnitude pyramid to <filename>.pyr, <samples> (power of 2) per entry at the finest\n", stderr);
+    fputs("       level, doubling up to the whole capture (see iqtool overview)\n", stderr);
+    fputs("   -j: compressor, DDC, resampler and channelizer threads, default all cores but two\n", stderr);
+    fprintf(stderr, "   -r: sample rate (k/M), default %.0fM, above %.2fM with -F sc8 on bladeRF 2.0 only\n", DEFAULT_SAMPLERATE / 1e6, MAX_SAMPLERATE / 1e6);
+    fputs("   -b: benchmark the storage backend with synthetic data, no device needed\n", stderr);
+}
+
+/* ring mode: where the stream starts and ends in the wrapped file */
+static void write_ring_info(const char *fname, const struct sink *s, struct trigger *t) {
+	FILE *fl = sidecar_open(fname, "ring");
+	if(!fl)
+		return;
+	size_t pos = (s->written > s->size) ? sink_pos(s) : 0;
+	fprintf(fl, "# read from start to the end of the file, then from 0 to end\n");
+	fprintf(fl, "size %zu\n", s->size);
+	fprintf(fl, "start %zu\n", pos);
+	fprintf(fl, "end %zu\n", (s->written > s->size) ? pos : s->written);
+	fprintf(fl, "first_sample %zu\n", (s->written - sink_used(s)) / s->ss);
+	if(trigger_fired(t))
+		fprintf(fl, "trigger_sample %" PRIu64 " %s\n", t->pos / s->ss, t->cause);
+	fclose(fl);
 }
 
 static float autoscale_float(float val, char *suffix) {
@@ -111,44 +143,562 @@ static float autoscale_float(float val, char *suffix) {
 	return val;
 }
 
+/* samples per second, k and M suffixes */
+static unsigned int parse_rate(const char *arg) {
+	char *end;
+	double rate = strtod(arg, &end);
+	if(*end == 'k')
+		rate *= 1e3;
+	else if(*end == 'M')
+		rate *= 1e6;
+	return (rate > 0 && rate < 4e9) ? (unsigned int)rate : 0;
+}
+
+/* bytes, or M/G/T */
 static size_t parse_fsize(const char *arg) {
 	int len = strlen(arg);
-	int suffix = arg[len-1];
-	size_t mult = 0;
+	int suffix = len ? arg[len-1] : 0;
+	size_t mult = isdigit(suffix) ? 1 : 0;
 	switch(suffix) {
 		case 'M' : mult=1000UL * 1000UL; break;
 		case 'G' : mult=1000UL * 1000UL * 1000UL; break;
 		case 'T' : mult=1000UL * 1000UL * 1000UL * 1000UL; break;
 	}
+	if(!mult) {
+		fprintf(stderr, "bad size: %s (bytes or M/G/T)\n", arg);
+		exit(1);
+	}
 	return strtoull(arg, NULL, 10) * mult;
 }
 
+struct rx {
+	struct bladerf *dev;           // NULL in benchmark mode
+	struct bladerf_metadata meta;
+	struct sink *sink;
+	struct pipeline *pl;           // NULL: receive straight into the sink
+	struct bladerf_stream *stream; // async stream mode
+	size_t ss;                     // bytes per sample: 4 (SC16 Q11) or 2 (SC8 Q7)
+	size_t remaining;              // bytes left to capture
+	_Atomic uint64_t out;          // stream bytes emitted, incl. zero fill
+	int res;
+	_Atomic int done;
+
+	// overrun handling
+	const char *fname;             // base name of the .gaps sidecar
+	FILE *gapfile;
+	int zero_fill;                 // keep sample-accurate timing
+	int resync;                    // next read with RX_NOW (start, after overrun)
+	uint64_t ts_next;              // expected timestamp of the next sample
+	uint64_t gap;                  // samples missing in front of the last block
+	size_t gaps;
+	uint64_t lost;
+
+	// trigger: capture ends tail bytes after it fired
+	struct trigger *trig;
+	uint64_t tail;
+	int triggered;
+	struct sink *memring;          // RAM ring: dumps on every trigger, NULL: off
+
+	struct tap *tap;               // analysis worker (spectrogram, pyramid), NULL: off
+
+	// stats
+	_Atomic long faults, majflt;   // page faults taken on the RX thread
+	long flt_base, majflt_base;
+	int flt_init;
+	FILE *logfile;
+	struct timeval tv_last, tv_next;
+	size_t written_last;
+	struct sink *comp;             // compressing sink, NULL: off
+	struct sink *squelch;          // squelch sink, NULL: off
+	size_t stored_last;
+};
+
+/* page faults of the calling (RX) thread since its first call */
+static void rx_faults(struct rx *rx) {
+	struct rusage ru;
+	if(getrusage(RUSAGE_THREAD, &ru))
+		return;
+	if(!rx->flt_init) {
+		rx->flt_base = ru.ru_minflt + ru.ru_majflt;
+		rx->majflt_base = ru.ru_majflt;
+		rx->flt_init = 1;
+	}
+	atomic_store(&rx->faults, ru.ru_minflt + ru.ru_majflt - rx->flt_base);
+	atomic_store(&rx->majflt, ru.ru_majflt - rx->majflt_base);
+}
+
+/*
+ * Timestamped read. An overrun ends a block early; the samples after it
+ * are gone, so the next read resyncs with RX_NOW and the timestamp jump
+ * tells how many samples were lost.
+ */
+static int rx_block(struct rx *rx, void *dst, size_t len) {
+	rx->gap = 0;
+	rx_faults(rx);
+	if(!rx->dev) {
+		// stand-in for the memcpy libbladeRF does into dst
+		memset(dst, 0x5a, len);
+		rx->meta.actual_count = len / rx->ss;
+		rx->meta.timestamp = rx->ts_next;
+		rx->ts_next += rx->meta.actual_count;
+		return 0;
+	}
+	do {
+		rx->meta.flags = rx->resync ? BLADERF_META_FLAG_RX_NOW : 0;
+		rx->meta.timestamp = rx->ts_next;
+		rx->res = bladerf_sync_rx(rx->dev, dst, len / rx->ss, &rx->meta, TIMEOUT_MS);  // 1 sample == 2 * 16 or 2 * 8 Bits
+		if(rx->res == BLADERF_ERR_TIME_PAST)
+			rx->resync = 1;
+	} while(rx->res == BLADERF_ERR_TIME_PAST);
+	if(rx->res)
+		return rx->res;
+
+	if(rx->resync && rx->ts_next && (rx->meta.timestamp > rx->ts_next))
+		rx->gap = rx->meta.timestamp - rx->ts_next;
+	rx->resync  = !!(rx->meta.status & BLADERF_META_STATUS_OVERRUN);
+	rx->ts_next = rx->meta.timestamp + rx->meta.actual_count;
+	return 0;
+}
+
+/* claims up to len bytes of the output */
+static size_t rx_take(struct rx *rx, size_t len) {
+	len = MIN(len, rx->remaining - rx->remaining % rx->ss);
+	rx->remaining -= len;
+	atomic_fetch_add(&rx->out, len);
+	return len;
+}
+
+/* once triggered, only the post-trigger tail is left to capture */
+static void rx_trigger(struct rx *rx) {
+	if(rx->memring || rx->triggered || !trigger_fired(rx->trig))
+		return;
+	rx->triggered = 1;
+	uint64_t end = rx->trig->pos + rx->tail, out = atomic_load(&rx->out);
+	rx->remaining = (end > out) ? MIN(rx->remaining, end - out) : 0;
+}
+
+/* logs a gap of missing samples starting at device time ts, returns the bytes to zero-fill */
+static size_t rx_gap(struct rx *rx, uint64_t missing, uint64_t ts) {
+	uint64_t offset = atomic_load(&rx->out) / rx->ss;
+
+	rx->gaps++;
+	rx->lost += missing;
+	if(!rx->gapfile && (rx->gapfile = sidecar_open(rx->fname, "gaps")))
+		fprintf(rx->gapfile, "# sample_offset missing_samples device_timestamp (%s)\n", rx->zero_fill ? "zero-filled" : "skipped");
+	if(rx->gapfile) {
+		fprintf(rx->gapfile, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n", offset, missing, ts);
+		fflush(rx->gapfile);
+	}
+	return rx->zero_fill ? rx_take(rx, missing * rx->ss) : 0;
+}
+
+/* RX thread of the pipeline: only moves buffers between pool and queue */
+static void *rx_thread(void *arg) {
+	struct rx *rx = arg;
+
+	while(!stop_flag && (rx_trigger(rx), rx->remaining >= rx->ss)) {
+		struct buf *b = pipeline_get(rx->pl);
+		if(!b)
+			break;
+		size_t len = MIN(b->cap, NUM_SAMPLES * rx->ss);
+		b->gap = 0;
+		if(rx_block(rx, b->data, MIN(len, rx->remaining))) {
+			b->len = 0;
+			pipeline_put(rx->pl, b);
+			break;
+		}
+		if(rx->gap)
+			b->gap = rx_gap(rx, rx->gap, rx->meta.timestamp - rx->gap);
+		b->len = rx_take(rx, rx->meta.actual_count * rx->ss);
+		b->ts = rx->meta.timestamp;
+		pipeline_put(rx->pl, b);
+	}
+	atomic_store(&rx->done, 1);
+	return NULL;
+}
+
+/*
+ * Async stream callback: libbladeRF hands over a filled buffer and wants
+ * the next one to receive into. The filled one goes to the writer as is and
+ * only comes back to the free queue once the sink has persisted it. That
+ * skips the copy of the sync API, but the sink still copies it unless it can
+ * write it in place: io_uring needs page aligned buffers, and libbladeRF
+ * allocates its own, usually not aligned. The writer reports how many were.
+ *
+ * There is no metadata in this mode, ts_next just counts samples since the
+ * stream started. If the writer is behind and no buffer is free, the filled
+ * buffer is dropped and received into again, which shows up as a gap.
+ */
+static void *stream_cb(struct bladerf *dev, struct bladerf_stream *stream, struct bladerf_metadata *meta,
+		void *samples, size_t num_samples, void *user_data) {
+	struct rx *rx = user_data;
+	struct pipeline *pl = rx->pl;
+	(void)dev; (void)stream; (void)meta;
+
+	rx_trigger(rx);
+	rx_faults(rx);
+	if(stop_flag || atomic_load(&pl->failed) || (rx->remaining < rx->ss))
+		return BLADERF_STREAM_SHUTDOWN;
+
+	uint64_t ts = rx->ts_next;
+	rx->ts_next += num_samples;
+
+	struct buf *b = pipeline_find(pl, samples), *next;
+	if(!b || !(next = spsc_pop(&pl->free))) {
+		atomic_fetch_add(&pl->starved, 1);
+		rx->gap += num_samples;
+		return samples;
+	}
+	b->gap = rx->gap ? rx_gap(rx, rx->gap, ts - rx->gap) : 0;
+	rx->gap = 0;
+	b->len = rx_take(rx, num_samples * rx->ss);
+	b->ts = ts;
+	pipeline_put(pl, b);
+	return next->data;
+}
+
+static void *stream_thread(void *arg) {
+	struct rx *rx = arg;
+	rx->res = bladerf_stream(rx->stream, BLADERF_RX_X1);
+	atomic_store(&rx->done, 1);
+	return NULL;
+}
+
+static void show_stats(struct rx *rx, size_t written) {
+	struct timeval tv_now, tv_sec = {.tv_sec=1};
+	char suffix;
+
+	gettimeofday(&tv_now, NULL);
+	if(!timercmp(&tv_now, &rx->tv_next, >=))
+		return;
+	timeradd(&tv_now, &tv_sec, &rx->tv_next);
+	if(rx->tv_last.tv_sec) {
+		struct timeval tmp;
+		timersub(&tv_now, &rx->tv_last, &tmp);
+		float delta_t = (float)tmp.tv_usec / 1000000.0;
+		delta_t += tmp.tv_sec;
+		float datarate = written - rx->written_last;
+		datarate /= delta_t;
+		datarate = autoscale_float(datarate, &suffix);
+		char suffix2;
+		float fv = autoscale_float(written, &suffix2);
+		printf("\r~%5.1f %cB/s, total: %6.2f %cB", datarate, suffix, fv, suffix2);
+		if(rx->pl) {
+			// buffers waiting for the writer - at nbufs the RX thread starves
+			printf(", queue: %3zu/%zu (max %3zu, starved %zu)", pipeline_fill(rx->pl), rx->pl->nbufs,
+				pipeline_fill_max(rx->pl), atomic_load(&rx->pl->starved));
+		}
+		if(rx->comp) {
+			size_t raw, stored;
+			sink_compress_stats(rx->comp, &raw, &stored);
+			float out_rate = autoscale_float((stored - rx->stored_last) / delta_t, &suffix);
+			printf(", ratio: %5.2f (%5.1f %cB/s out)", stored ? (float)raw / stored : 0, out_rate, suffix);
+			rx->stored_last = stored;
+		}
+		if(rx->squelch) {
+			uint64_t dropped;
+			size_t bursts;
+			sink_squelch_stats(rx->squelch, &dropped, &bursts);
+			printf(", kept: %5.1f%% in %zu bursts", written ? 100 - 100.0 * dropped * rx->ss / written : 0, bursts);
+		}
+		printf(", RX faults: %ld", atomic_load(&rx->faults));
+		if(rx->triggered)
+			printf(", TRIGGERED (%s)", rx->trig->cause);
+		if(rx->memring) {
+			unsigned events;
+			int dumping;
+			sink_memring_stats(rx->memring, &events, &dumping);
+			printf(", events: %u%s", events, dumping ? " (dumping)" : "");
+		}
+		fflush(stdout);
+		if(rx->logfile) {
+			fprintf(rx->logfile, "%ld.%ld %zu\n", tv_now.tv_sec, tv_now.tv_usec, written / rx->ss);
+			fflush(rx->logfile);
+		}
+	}
+	rx->tv_last = tv_now;
+	rx->written_last = written;
+}
+
+/* RX loop writing straight into the sink */
+static void rx_direct(struct rx *rx) {
+	while(!stop_flag && (rx_trigger(rx), rx->remaining >= rx->ss)) {
+		size_t len = NUM_SAMPLES * rx->ss;
+		void *dst;
+
+		if((rx->res = sink_get(rx->sink, &dst, &len)) || (len < rx->ss))
+			break;
+		if(rx_block(rx, dst, MIN(len, rx->remaining)))
+			break;
+		len = rx->meta.actual_count * rx->ss;
+		void *tmp = NULL;
+		size_t fill = rx->gap ? rx_gap(rx, rx->gap, rx->meta.timestamp - rx->gap) : 0;
+		if(fill) {
+			// the block already sits where the zeros go, move it behind them
+			if(!(tmp = malloc(len))) {
+				rx->res = -1;
+				break;
+			}
+			memcpy(tmp, dst, len);
+			if((rx->res = sink_zero(rx->sink, fill))) {
+				free(tmp);
+				break;
+			}
+		}
+		const void *blk = tmp ? tmp : dst;
+		trigger_power(rx->trig, blk, len / rx->ss, atomic_load(&rx->out));
+		if(rx->tap)
+			tap_feed(rx->tap, blk, len / rx->ss, atomic_load(&rx->out) / rx->ss);
+		sink_mark(rx->sink, rx->meta.timestamp);
+		len = rx_take(rx, len);
+		rx->res = tmp ? sink_copy(rx->sink, tmp, len) : sink_put(rx->sink, len);
+		free(tmp);
+		if(rx->res)
+			break;
+		if(trigger_poll(rx->trig, atomic_load(&rx->out)) == CTRL_STOP)
+			stop_flag = 1;
+		show_stats(rx, rx->sink->written);
+	} // rx loop
+}
+
+/* pipeline tap: power trigger and analysis copy on the writer thread */
+static void rx_tap(void *ctx, struct buf *b, uint64_t pos) {
+	struct rx *rx = ctx;
+	trigger_power(rx->trig, b->data, b->len / rx->ss, pos);
+	if(rx->tap)
+		tap_feed(rx->tap, b->data, b->len / rx->ss, pos / rx->ss);
+}
+
+static int tap_spectro(void *ctx, const void *iq, size_t n, uint64_t pos) {
+	return spectro_run(ctx, iq, n, pos);
+}
+
+static int tap_pyramid(void *ctx, const void *iq, size_t n, uint64_t pos) {
+	return pyramid_run(ctx, iq, n, pos);
+}
+
+/* RX on its own thread, stats from here */
+static void rx_pipelined(struct rx *rx) {
+	pthread_t thread;
+	struct timespec ts = {.tv_nsec = 100000000};
+
+	if(pthread_create(&thread, NULL, rx->stream ? stream_thread : rx_thread, rx)) {
+		perror("pthread_create");
+		return;
+	}
+	while(!atomic_load(&rx->done)) {
+		nanosleep(&ts, NULL);
+		if(trigger_poll(rx->trig, atomic_load(&rx->out)) == CTRL_STOP)
+			stop_flag = 1;
+		show_stats(rx, atomic_load(&rx->pl->written));
+	}
+	pthread_join(thread, NULL);
+}
+
 int main(int argc, char **argv) {
-	struct bladerf_metadata meta = {.flags = BLADERF_META_FLAG_RX_NOW};
+	struct rx rx = {.resync = 1};
 	struct bladerf *dev = NULL;
-	struct mf mf;
-	const char *fname = NULL, *log_fname = NULL;
-	size_t written = 0, max_size = 0, written_last = 0;
-	int manual_gain = INT_MIN, res, opt;
-	struct timeval tv_now, tv_last = {0}, tv_next = {0}, tv_sec = {.tv_sec=1};
+	struct sink disk, comp, packed, down, resampled, squelch, *sink = &disk;
+	struct pipeline pl;
+	struct trigger trig;
+	const char *fname = NULL, *files[STRIPE_MAX], *log_fname = NULL, *fifo = NULL, *ddc_spec = NULL, *rs_spec = NULL, *chan_spec = NULL, *xtr_spec = NULL, *spec_spec = NULL;
+	int act_bands = 0, pyr_base = 0;
+	struct ddc ddc = {0};
+	struct resamp rs = {0};
+	struct pfb pfb = {0};
+	struct ols ols = {0};
+	struct spectro spec = {0};
+	struct pyramid pyr = {0};
+	struct tap tap = {0};
+	size_t stored = 0;              // -K, -X and -m: bytes in all their files
+	int oversample = 0;
+	size_t written = 0, max_size = 0, pool_bufs = 0, seg_size = 0;
+	unsigned int samplerate = DEFAULT_SAMPLERATE;
+	const struct codec *codec = NULL;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN) - 2;
+	int level = 0;
+	int manual_gain = INT_MIN, res = 0, opt, nfiles = 0, sc8 = 0, pack = 0, backend = SINK_MMAP, bench = 0, async = 0, ring = 0, memring = 0;
+	unsigned mr_events = 0;
+	float tail_s = 0, trig_dbfs = NAN, seg_s = 0;
+	float sq_dbfs = NAN, sq_hyst = 3, sq_pre = 0.01, sq_post = 0.05;
+	struct sink *sq_inner = NULL;
+	size_t sq_bursts = 0;
+	char base[PATH_MAX];
+	void **stream_bufs = NULL;
+	struct timeval tv_now, tv_start = {0};
 	FILE *logfile = NULL;
 	char suffix;
 	float fv;
 
     // Parse args
-    while ((opt = getopt(argc, argv, "f:s:g:l:")) != -1) {
+    while ((opt = getopt(argc, argv, "f:s:g:l:o:p:abzwmT:e:c:S:t:d:P:HF:C:D:R:K:OX:W:A:M:Q:j:r:")) != -1) {
         switch(opt) {
-            case 'f': fname = optarg; break;
+            case 'f':
+                if (nfiles == STRIPE_MAX) {
+                    fprintf(stderr, "at most %d files\n", STRIPE_MAX);
+                    return 1;
+                }
+                fname = files[nfiles++] = optarg;
+                break;
             case 's': max_size = parse_fsize(optarg); break;
             case 'g': manual_gain = atoi(optarg); break;
             case 'l': log_fname = optarg; break;
+            case 'o':
+                if ((backend = sink_parse_backend(optarg)) < 0) {
+                    fprintf(stderr, "unknown storage backend: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'p': pool_bufs = strtoul(optarg, NULL, 10); break;
+            case 'a': async = 1; break;
+            case 'b': bench = 1; break;
+            case 'z': rx.zero_fill = 1; break;
+            case 'w': ring = 1; break;
+            case 'm': memring = 1; break;
+            case 'T': tail_s = atof(optarg); break;
+            case 'e': trig_dbfs = atof(optarg); break;
+            case 'c': fifo = optarg; break;
+            case 'S': seg_size = parse_fsize(optarg); break;
+            case 't': seg_s = atof(optarg); break;
+            case 'd': sink_dirty_max = parse_fsize(optarg); break;
+            case 'H': sink_hugepages = 1; break;
+            case 'F':
+                if (strcmp(optarg, "sc8") && strcmp(optarg, "sc16") && strcmp(optarg, "packed12")) {
+                    fprintf(stderr, "unknown sample format: %s\n", optarg);
+                    return 1;
+                }
+                sc8 = !strcmp(optarg, "sc8");
+                pack = !strcmp(optarg, "packed12");
+                break;
+            case 'C':
+                if (!(codec = codec_parse(optarg, &level))) {
+                    fprintf(stderr, "unknown codec: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'D': ddc_spec = optarg; break;
+            case 'R': rs_spec = optarg; break;
+            case 'K': chan_spec = optarg; break;
+            case 'O': oversample = 1; break;
+            case 'X': xtr_spec = optarg; break;
+            case 'W': spec_spec = optarg; break;
+            case 'A': act_bands = atoi(optarg); break;
+            case 'M': pyr_base = atoi(optarg); break;
+            case 'Q':
+                if (sscanf(optarg, "%f:%f:%f:%f", &sq_dbfs, &sq_hyst, &sq_pre, &sq_post) < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'j': threads = atol(optarg); break;
+            case 'r': samplerate = parse_rate(optarg); break;
+            case 'P': sink_prefault = parse_fsize(optarg); break;
             default: usage(argv[0]); return 1;
         }
     }
-    if (!fname || !max_size) {
+    if (!fname || !max_size || (async && bench)) {
         usage(argv[0]);
         return 1;
     }
+	rx.ss = sink_sample_size = sc8 ? 2 : 4;
+	if(!samplerate || (samplerate > MAX_SAMPLERATE && !sc8)) {
+		fprintf(stderr, "sample rates above %.2f MS/s need -F sc8\n", MAX_SAMPLERATE / 1e6);
+		return 1;
+	}
+	if(pack) {
+		if(ring) {
+			fputs("packed12 can't be combined with -w\n", stderr);
+			return 1;
+		}
+		// packing runs on the writer thread
+		pool_bufs = pool_bufs ? pool_bufs : NUM_BUFFERS;
+	}
+	if(seg_s > 0) {
+		size_t sz = (size_t)(seg_s * samplerate) * (pack ? PACK12_BYTES : rx.ss);
+		seg_size = seg_size ? MIN(seg_size, sz) : sz;
+	}
+	// the segmented sink cuts on 4 KiB, packed12 segments also have to end on a whole sample
+	if(pack && seg_size > PACK12_BYTES * 4096)
+		seg_size -= seg_size % (PACK12_BYTES * 4096);
+	if(memring) {
+		if(ring || seg_s > 0 || seg_size || pack || codec || ddc_spec || rs_spec || chan_spec || xtr_spec ||
+				nfiles > 1 || !isnan(sq_dbfs) || pyr_base) {
+			fputs("-m can't be combined with -w, -S, -t, -C, -D, -R, -K, -X, -Q, -M, packed12 or striping\n", stderr);
+			return 1;
+		}
+		if(!strchr(fname, '%')) {
+			fputs("-m needs a %d pattern in the filename\n", stderr);
+			return 1;
+		}
+		// anonymous hugepages for the ring, whether -H was given or not
+		sink_hugepages = 1;
+	}
+	else if(chan_spec || xtr_spec) {
+		if(ring || seg_size || pack || codec || ddc_spec || rs_spec || nfiles > 1 || (chan_spec && xtr_spec)) {
+			fputs("-K and -X can't be combined with -w, -S, -t, -C, -D, -R, packed12, striping or each other\n", stderr);
+			return 1;
+		}
+		if(!strchr(fname, '%')) {
+			fputs("-K and -X need a %d pattern in the filename\n", stderr);
+			return 1;
+		}
+		if(chan_spec && pfb_parse(&pfb, chan_spec, oversample, samplerate, rx.ss))
+			return 1;
+		if(xtr_spec && ols_parse(&ols, xtr_spec, samplerate, rx.ss))
+			return 1;
+	}
+	else if(!seg_size != !strchr(fname, '%') || (seg_size && ring)) {
+		fputs("segmented output needs a %d pattern in the filename and -S or -t, and no -w\n", stderr);
+		return 1;
+	}
+	if(ddc_spec) {
+		if(ring || seg_size || pack) {
+			fputs("the DDC can't be combined with -w, -S, -t or packed12\n", stderr);
+			return 1;
+		}
+		if(ddc_parse(&ddc, ddc_spec, samplerate, rx.ss))
+			return 1;
+	}
+	if(rs_spec) {
+		if(ring || seg_size || pack) {
+			fputs("the resampler can't be combined with -w, -S, -t or packed12\n", stderr);
+			return 1;
+		}
+		if(resamp_parse(&rs, rs_spec, ddc_spec ? ddc.out_rate : samplerate, ddc_spec ? 4 : rx.ss))
+			return 1;
+	}
+	// the index works off the spectrogram's rows, with or without keeping them
+	if((spec_spec || act_bands) && spectro_parse(&spec, spec_spec ? spec_spec : "1024", samplerate, rx.ss))
+		return 1;
+	if(pyr_base && ring) {
+		fputs("the magnitude pyramid can't be combined with -w\n", stderr);
+		return 1;
+	}
+	if(!isnan(sq_dbfs) && (ring || ddc_spec || rs_spec || chan_spec || xtr_spec)) {
+		fputs("the squelch can't be combined with -w, -D, -R, -K or -X\n", stderr);
+		return 1;
+	}
+	if(!isnan(sq_dbfs) && (sq_hyst < 0 || sq_pre < 0 || sq_post < 0)) {
+		fputs("squelch hysteresis and pre/post roll can't be negative\n", stderr);
+		return 1;
+	}
+	if(codec && (seg_size || ring)) {
+		fputs("compression can't be combined with -w, -S or -t\n", stderr);
+		return 1;
+	}
+	if(codec && codec->ss && (pack || codec->ss != ((ddc_spec || rs_spec) ? 4 : rx.ss))) {
+		fprintf(stderr, "the %s codec needs %zu byte samples\n", codec->name, codec->ss);
+		return 1;
+	}
+	if(codec && codec->lossy && manual_gain == INT_MIN)
+		fprintf(stderr, "note: with AGC the noise floor the %s codec adapts to may move within a block, consider -g\n", codec->name);
+	threads = (threads > 0) ? threads : 1;
+	if(nfiles > 1 && (seg_size || ring)) {
+		fputs("striping can't be combined with -w, -S or -t\n", stderr);
+		return 1;
+	}
+	fname = files[0];
+	segment_basename(base, sizeof(base), fname);
 
 	if(log_fname) {
 		logfile = fopen(log_fname, "wx");
@@ -158,9 +708,52 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	if(create_file(&mf, fname, max_size))
+	// the RAM ring's dump thread watches the trigger from the start
+	if(trigger_init(&trig, fifo, trig_dbfs, rx.ss))
 		return -1;
 
+	// room for incompressible data, the file is cut to size at the end
+	size_t file_size = codec ? iqz_bound(max_size) : max_size;
+	if(memring)
+		res = sink_open_memring(&disk, backend, fname, max_size, &trig, (size_t)(tail_s * samplerate) * rx.ss, &mr_events, &stored);
+	else if(chan_spec)
+		res = sink_open_channels(&disk, backend, fname, max_size, &pfb, threads, &stored);
+	else if(xtr_spec)
+		res = sink_open_extract(&disk, backend, fname, max_size, &ols, threads, &stored);
+	else if(nfiles > 1)
+		res = sink_open_striped(&disk, backend, files, nfiles, file_size);
+	else if(seg_size)
+		res = sink_open_segmented(&disk, backend, fname, file_size, seg_size);
+	else
+		res = sink_open(&disk, backend, fname, file_size, ring);
+	if(!res && codec) {
+		res = sink_open_compressed(&comp, sink, max_size, codec, level, threads);
+		sink = rx.comp = &comp;
+	}
+	if(!res && rs_spec) {
+		res = sink_open_resample(&resampled, sink, &rs, threads);
+		sink = &resampled;
+	}
+	if(!res && ddc_spec) {
+		res = sink_open_downconv(&down, sink, &ddc, threads);
+		sink = &down;
+	}
+	if(!res && pack) {
+		res = sink_open_packed(&packed, sink);
+		sink = &packed;
+	}
+	// -s counts received bytes, what's stored is less
+	if(!res && !isnan(sq_dbfs)) {
+		sq_inner = sink;
+		res = sink_open_squelch(&squelch, sink, max_size, base, sq_dbfs, sq_hyst,
+			sq_pre * samplerate, sq_post * samplerate);
+		sink = rx.squelch = &squelch;
+	}
+	if(res) {
+		trigger_close(&trig);
+		return -1;
+	}
+
 	// Setup signal handlers
 	struct sigaction sa;
 	sa.sa_handler = handle_signal;
@@ -169,16 +762,25 @@ int main(int argc, char **argv) {
 	sigaction(SIGINT, &sa, NULL);
 	sigaction(SIGTERM, &sa, NULL);
 
+	if(bench)
+		goto receive;
+
     // Open bladeRF
     if ((res = bladerf_open(&dev, NULL)) != 0) {
         fprintf(stderr, "Failed to open bladeRF: %s\n", bladerf_strerror(res));
-        return -1;
+        goto cleanup;
     }
 
-    // Configure RX channel 0
+	// bladeRF 2.0 only, has to be on before the sample rate is set
+	if(samplerate > MAX_SAMPLERATE && (res = bladerf_enable_feature(dev, BLADERF_FEATURE_OVERSAMPLE, true)) != 0) {
+		fprintf(stderr, "Failed to enable oversampling: %s\n", bladerf_strerror(res));
+		goto cleanup;
+	}
+
+    // Configure RX channel 0, bandwidth 7/8 of the sample rate
     if ((res = bladerf_set_frequency(dev, BLADERF_CHANNEL_RX(0), DEFAULT_FREQ)) != 0 ||
-        (res = bladerf_set_sample_rate(dev, BLADERF_CHANNEL_RX(0), DEFAULT_SAMPLERATE, NULL)) != 0 ||
-        (res = bladerf_set_bandwidth(dev, BLADERF_CHANNEL_RX(0), DEFAULT_BANDWIDTH, NULL)) != 0) {
+        (res = bladerf_set_sample_rate(dev, BLADERF_CHANNEL_RX(0), samplerate, &samplerate)) != 0 ||
+        (res = bladerf_set_bandwidth(dev, BLADERF_CHANNEL_RX(0), samplerate / 8 * 7, NULL)) != 0) {
         fprintf(stderr, "Failed to configure bladeRF: %s\n", bladerf_strerror(res));
         goto cleanup;
     }
@@ -199,14 +801,33 @@ int main(int argc, char **argv) {
 		}
 	}
 
-	res = bladerf_sync_config(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC16_Q11_META,
+	if(async) {
+		// the stream buffers double as the pool, no metadata in this mode
+		pool_bufs = pool_bufs ? pool_bufs : NUM_BUFFERS;
+		if(pool_bufs <= NUM_TRANSFERS) {
+			fprintf(stderr, "async mode needs more than %d buffers\n", NUM_TRANSFERS);
+			res = -1;
+			goto cleanup;
+		}
+		res = bladerf_init_stream(&rx.stream, dev, stream_cb, &stream_bufs, pool_bufs,
+			sc8 ? BLADERF_FORMAT_SC8_Q7 : BLADERF_FORMAT_SC16_Q11, NUM_SAMPLES, NUM_TRANSFERS, &rx);
+		if(!res)
+			res = bladerf_set_stream_timeout(dev, BLADERF_RX, TIMEOUT_MS);
+		if(res) {
+			fprintf(stderr, "Failed to configure RX stream: %s\n", bladerf_strerror(res));
+			goto cleanup;
+		}
+	}
+	else {
+		res = bladerf_sync_config(dev, BLADERF_RX_X1, sc8 ? BLADERF_FORMAT_SC8_Q7_META : BLADERF_FORMAT_SC16_Q11_META,
                                  NUM_BUFFERS, NUM_SAMPLES, NUM_TRANSFERS,
                                  TIMEOUT_MS);
-    if (res != 0) {
-        fprintf(stderr, "Failed to configure RX sync interface: %s\n",
+		if (res != 0) {
+			fprintf(stderr, "Failed to configure RX sync interface: %s\n",
                 bladerf_strerror(res));
-        return res;
-    }
+			goto cleanup;
+		}
+	}
 
     // Enable RX
     if ((res = bladerf_enable_module(dev, BLADERF_CHANNEL_RX(0), true)) != 0) {
@@ -214,62 +835,178 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
-    fprintf(stderr, "Receiving... Press Ctrl+C to abort.\n");
-
-	size_t remaining = mf.map_size / 4;	// convert bytes to samples
-	uint32_t *dst    = mf.map_base;		// 1 sample == 2 * 16 Bits
-	int overrun = 0;
-
-	while(!stop_flag && !overrun && remaining && !(res = bladerf_sync_rx(dev, dst, MIN(remaining,NUM_SAMPLES), &meta, TIMEOUT_MS))) {
-		gettimeofday(&tv_now, NULL);
+receive:
+	rx.dev = dev;
+	rx.sink = sink;
+	rx.logfile = logfile;
+	rx.fname = base;
+	rx.remaining = (ring || memring) ? SIZE_MAX : sink->size;
+	rx.memring = memring ? sink : NULL;
+	rx.trig = &trig;
+	rx.tail = (uint64_t)(tail_s * samplerate) * rx.ss;
+	if(spec_spec || act_bands || pyr_base) {
+		// query can only copy ranges out of a file that is the stream as received
+		int linear = !pack && !codec && !ring && !memring && !seg_size && (nfiles < 2) && isnan(sq_dbfs) &&
+			!ddc_spec && !rs_spec && !chan_spec && !xtr_spec;
+		FILE *fl;
+		// the device may have picked a slightly different rate
+		spec.rate = samplerate;
+		if((spec_spec && (!(fl = sidecar_open(base, "spec")) || spectro_open(&spec, fl))) ||
+				(act_bands && (!(fl = sidecar_open(base, "act")) || spectro_open_index(&spec, fl, act_bands, linear))) ||
+				(pyr_base && (!(fl = sidecar_open(base, "pyr")) ||
+					pyramid_open(&pyr, fl, samplerate, rx.ss, pyr_base, rx.remaining / rx.ss)))) {
+			res = -1;
+			goto cleanup;
+		}
+		if(spec_spec || act_bands)
+			tap_add(&tap, tap_spectro, &spec);
+		if(pyr_base)
+			tap_add(&tap, tap_pyramid, &pyr);
+		if(tap_start(&tap, rx.ss, NUM_SAMPLES * rx.ss)) {
+			res = -1;
+			goto cleanup;
+		}
+		rx.tap = &tap;
+	}
+	if(pool_bufs) {
+		if(pipeline_start(&pl, sink, pool_bufs, NUM_SAMPLES * rx.ss, stream_bufs)) {
+			res = -1;
+			goto cleanup;
+		}
+		rx.pl = &pl;
+		pl.tap = rx_tap;
+		pl.tap_ctx = &rx;
+		// libbladeRF starts out receiving into the first NUM_TRANSFERS stream buffers
+		for(int i = 0; stream_bufs && (i < NUM_TRANSFERS); i++)
+			spsc_pop(&pl.free);
+	}
 
-		remaining -= meta.actual_count;
-		dst       += meta.actual_count;
-		written   += meta.actual_count * 4;
-		overrun    = meta.status & BLADERF_META_STATUS_OVERRUN;
-
-		/* show stats */
-		if(timercmp(&tv_now, &tv_next, >=)) {
-			timeradd(&tv_now, &tv_sec, &tv_next);
-			if(tv_last.tv_sec) {
-				struct timeval tmp;
-				timersub(&tv_now, &tv_last, &tmp);
-				float delta_t = (float)tmp.tv_usec / 1000000.0;
-				delta_t += tmp.tv_sec;
-				float datarate = written - written_last;
-				datarate /= delta_t;
-				datarate = autoscale_float(datarate, &suffix);
-				char suffix2;
-				fv = autoscale_float(written, &suffix2);
-				printf("\r~%5.1f %cB/s, total: %6.2f %cB", datarate, suffix, fv, suffix2);
-				fflush(stdout);
-				if(logfile) {
-					fprintf(logfile, "%ld.%ld %zu\n", tv_now.tv_sec, tv_now.tv_usec, written>>2);
-					fflush(logfile);
-				}
-			}
-			tv_last = tv_now;
-			written_last = written;
-		} // show stats
+    fprintf(stderr, "%s (%s backend, %s, %.2f MS/s)... Press Ctrl+C to abort.\n", bench ? "Benchmarking" : "Receiving",
+		disk.ops->name, sc8 ? "SC8 Q7" : pack ? "packed12" : "SC16 Q11", samplerate / 1e6);
+	if(pack)
+		fprintf(stderr, "packing with the %s kernel\n", pack12_name());
+	if(ddc_spec) {
+		FILE *fl = sidecar_open(fname, "ddc");
+		if(fl) {
+			ddc_describe(&ddc, fl);
+			fclose(fl);
+		}
+		fprintf(stderr, "downconverting %.0f Hz to %.2f kS/s in %d stages on %ld threads\n",
+			ddc.offset, ddc.out_rate / 1e3, ddc.nstages, threads);
+	}
+	if(rs_spec) {
+		FILE *fl = sidecar_open(fname, "resamp");
+		if(fl) {
+			resamp_describe(&rs, fl);
+			fclose(fl);
+		}
+		fprintf(stderr, "resampling %.2f to %.3f kS/s (%d/%d, %d taps per phase) on %ld threads\n",
+			rs.rate / 1e3, rs.out_rate / 1e3, rs.l, rs.m, rs.taps, threads);
+	}
+	if(chan_spec)
+		fprintf(stderr, "channelizing into %d channels of %.2f kHz at %.2f kS/s, storing %d, on %ld threads\n",
+			pfb.nch, samplerate / 1e3 / pfb.nch, samplerate / 1e3 / pfb.decim, pfb.nsel, threads);
+	if(xtr_spec)
+		fprintf(stderr, "extracting %d channels with a %d point FFT on %ld threads\n", ols.nch, ols.n, threads);
+	if(spec_spec)
+		fprintf(stderr, "spectrogram: %d point FFT, %d frames (%.3f s) per row to %s.spec\n",
+			spec.n, spec.frames, spectro_row_time(&spec), base);
+	if(act_bands)
+		fprintf(stderr, "activity index: %d bands per %.3f s to %s.act\n", act_bands, spectro_row_time(&spec), base);
+	if(pyr_base)
+		fprintf(stderr, "magnitude pyramid: %d samples per entry, %u levels to %s.pyr\n", pyr_base, pyr.hdr.levels, base);
+	if(memring)
+		fprintf(stderr, "RAM ring: %.1f s before and %.1f s after each trigger to %s, listed in %s.events\n",
+			max_size / 8 * 7 / (double)rx.ss / samplerate, tail_s, fname, base);
+	if(rx.squelch)
+		fprintf(stderr, "squelch: open at %.1f dBFS, closed below %.1f dBFS, %.3f s pre and %.3f s post roll, left out stretches to %s.squelch\n",
+			sq_dbfs, sq_dbfs - sq_hyst, sq_pre, sq_post, base);
+	if(codec)
+		fprintf(stderr, "compressing with %s level %d on %ld threads\n", codec->name, level, threads);
+
+	gettimeofday(&tv_start, NULL);
+
+	if(rx.pl) {
+		rx_pipelined(&rx);
+		pipeline_stop(&pl);
+		// only page aligned buffers go to disk without a copy (io_uring)
+		fprintf(stderr, "\n%s buffers: %zu of %zu written in place, the rest copied\n",
+			stream_bufs ? "stream" : "pool", sink_in_place, pl.handed);
+	}
+	else
+		rx_direct(&rx);
+	res = rx.res;
+	if(rx.pl && atomic_load(&pl.failed)) {
+		fputs("\nwriter failed, capture aborted\n", stderr);
+		res = -1;
+	}
 
-		//printf("%x %d %d\n",meta.res,meta.actual_count,overrun);
-	} // rx loop
+	if(dev)
+		bladerf_enable_module(dev, BLADERF_CHANNEL_RX(0), false);
 
-    bladerf_enable_module(dev, BLADERF_CHANNEL_RX(0), false);
+	printf("\r%100s\r","");
 
-	printf("\r%40s\r","");
+	if(rx.squelch) {
+		uint64_t dropped;
+		sink_squelch_stats(rx.squelch, &dropped, &sq_bursts);
+	}
 
-	if(overrun)
-		fputs("OVERRUN OCCURRED!\n", stderr);
+	if(rx.gaps) {
+		fprintf(stderr, "OVERRUN OCCURRED %zu times, %" PRIu64 " samples lost (%s, see %s.gaps)\n",
+			rx.gaps, rx.lost, rx.zero_fill ? "zero-filled" : "skipped", base);
+	}
 
 cleanup:
-	close_file(&mf, written);
+	if(rx.stream)
+		bladerf_deinit_stream(rx.stream);
+	sink_close(sink);
+	if(atomic_load(&tap.dropped))
+		fprintf(stderr, "analysis fell behind, %" PRIu64 " samples left out\n", atomic_load(&tap.dropped));
+	if(tap_stop(&tap) | spectro_close(&spec) | pyramid_close(&pyr))
+		res = -1;
+	written = (chan_spec || xtr_spec || memring) ? stored : disk.written;
+	if(ring)
+		write_ring_info(fname, sink, &trig);
+	trigger_close(&trig);
+	ddc_free(&ddc);
+	resamp_free(&rs);
+	pfb_free(&pfb);
+	ols_free(&ols);
 	if(logfile)
 		fclose(logfile);
+	if(rx.gapfile)
+		fclose(rx.gapfile);
 	bladerf_close(dev);
 
+	if(bench) {
+		struct timeval tmp;
+		gettimeofday(&tv_now, NULL);
+		timersub(&tv_now, &tv_start, &tmp);
+		float delta_t = tmp.tv_sec + (float)tmp.tv_usec / 1000000.0;
+		float needed = (float)samplerate * rx.ss;
+		float datarate = sink->written / delta_t;
+		printf("%s: %.1f MB/s sustained incl. final sync, %.2fx the %.1f MB/s needed for %.2f MS/s, %.2f s stalled on storage\n",
+			sink->ops->name, datarate / 1e6, datarate / needed, needed / 1e6, samplerate / 1e6, sink->stall_us / 1e6);
+	}
+
+	if(codec && written)
+		fprintf(stderr, "compressed %zu bytes to %zu (ratio %.2f)\n", comp.written, written, (float)comp.written / written);
+
+	if(memring)
+		fprintf(stderr, "%u events dumped, see %s.events\n", mr_events, base);
+
+	// the inner sink's count is still there after closing
+	if(rx.squelch && squelch.written)
+		fprintf(stderr, "squelch kept %zu of %zu samples (%.2f%%) in %zu bursts, see %s.squelch\n",
+			sq_inner->written / rx.ss, squelch.written / rx.ss, 100.0 * sq_inner->written / squelch.written, sq_bursts, base);
+
+	fprintf(stderr, "page faults on the RX thread: %ld (%ld major)\n", atomic_load(&rx.faults), atomic_load(&rx.majflt));
+
 	fv = autoscale_float(written, &suffix);
 	printf("wrote %.2f %cBytes (%zu Bytes)\n",fv,suffix,written);
 
+	// a lost write fails the capture even if it was stopped by hand
+	if(rx.pl && atomic_load(&pl.failed))
+		return 1;
     return (res == 0 || stop_flag) ? 0 : 1;
 }
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "blockpool.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define POLL_NS     200000
+
+enum {
+	BLK_FREE = 0,
+	BLK_QUEUED,     // filled, waiting for a worker
+	BLK_DONE,       // processed, waiting to be stored
+};
+
+static void idle(void) {
+	struct timespec ts = {.tv_nsec = POLL_NS};
+	nanosleep(&ts, NULL);
+}
+
+static void *bpool_worker(void *arg) {
+	struct bpool_worker *w = arg;
+	struct bpool *p = w->p;
+
+	for (;;) {
+		size_t k = atomic_load(&p->taken);
+		if (k == atomic_load(&p->queued)) {
+			if (atomic_load(&p->stop))
+				break;
+			idle();
+			continue;
+		}
+		if (!atomic_compare_exchange_weak(&p->taken, &k, k + 1))
+			continue;
+		struct pblk *b = &p->blk[k % p->nslots];
+		p->work(p->owner, w->ctx, b);
+		atomic_store(&b->state, BLK_DONE);
+	}
+	return NULL;
+}
+
+/* stores finished blocks in order, wait: until all queued ones are stored */
+static int bpool_drain(struct bpool *p, int wait) {
+	while (p->stored < atomic_load(&p->queued)) {
+		struct pblk *b = &p->blk[p->stored % p->nslots];
+		if (atomic_load(&b->state) != BLK_DONE) {
+			if (!wait)
+				break;
+			idle();
+			continue;
+		}
+		if (p->store(p->owner, b)) {
+			p->failed = 1;
+			return -1;
+		}
+		atomic_store(&b->state, BLK_FREE);
+		p->stored++;
+	}
+	return 0;
+}
+
+static void bpool_submit(struct bpool *p) {
+	atomic_store(&p->cur->state, BLK_QUEUED);
+	atomic_fetch_add(&p->queued, 1);
+	p->cur = NULL;
+}
+
+int bpool_get(struct bpool *p, void **dst, size_t *len, uint64_t *stall_us) {
+	if (p->failed || bpool_drain(p, 0))
+		return -1;
+	if (!p->cur) {
+		size_t seq = atomic_load(&p->queued);
+		struct pblk *b = &p->blk[seq % p->nslots];
+		if (atomic_load(&b->state) != BLK_FREE) {
+			// all slots busy: the workers don't keep up
+			struct timeval t0, t1;
+			gettimeofday(&t0, NULL);
+			while (atomic_load(&b->state) != BLK_FREE) {
+				if (bpool_drain(p, 0))
+					return -1;
+				idle();
+			}
+			gettimeofday(&t1, NULL);
+			*stall_us += (t1.tv_sec - t0.tv_sec) * 1000000ULL + (t1.tv_usec - t0.tv_usec);
+		}
+		if (p->hist) {
+			// the previous block is full and its slot not reused before this one is
+			struct pblk *prev = seq ? &p->blk[(seq - 1) % p->nslots] : NULL;
+			if (prev)
+				memcpy(b->in, prev->in + p->block, p->hist);
+			else
+				memset(b->in, 0, p->hist);
+		}
+		b->len = 0;
+		b->seq = seq;
+		p->cur = b;
+	}
+	*len = MIN(*len, p->block - p->cur->len);
+	*dst = p->cur->in + p->hist + p->cur->len;
+	return 0;
+}
+
+int bpool_put(struct bpool *p, size_t len) {
+	p->cur->len += len;
+	if (p->cur->len == p->block)
+		bpool_submit(p);
+	return p->failed ? -1 : 0;
+}
+
+int bpool_finish(struct bpool *p) {
+	if (p->cur && p->cur->len)
+		bpool_submit(p);
+	if (p->failed)
+		return -1;
+	return bpool_drain(p, 1);
+}
+
+void bpool_stop(struct bpool *p) {
+	atomic_store(&p->stop, 1);
+	for (int i = 0; p->w && (i < p->nthreads); i++) {
+		if (p->w[i].running)
+			pthread_join(p->w[i].thread, NULL);
+		if (p->w[i].ctx && p->ctx_free)
+			p->ctx_free(p->w[i].ctx);
+	}
+	for (size_t i = 0; p->blk && (i < p->nslots); i++) {
+		free(p->blk[i].in);
+		free(p->blk[i].out);
+	}
+	free(p->blk);
+	free(p->w);
+	p->blk = NULL;
+	p->w = NULL;
+}
+
+int bpool_start(struct bpool *p, size_t block, size_t hist, size_t out_cap, int nthreads, void *owner,
+	void *(*ctx_new)(void *owner), void (*ctx_free)(void *ctx),
+	void (*work)(void *owner, void *ctx, struct pblk *b), int (*store)(void *owner, struct pblk *b))
+{
+	memset(p, 0, sizeof(struct bpool));
+	p->block = block;
+	p->hist = hist;
+	p->out_cap = out_cap;
+	p->nthreads = nthreads;
+	p->owner = owner;
+	p->work = work;
+	p->store = store;
+	p->ctx_free = ctx_free;
+	// enough blocks in flight for every worker plus the one being filled
+	p->nslots = 2 * nthreads + 2;
+	p->blk = calloc(p->nslots, sizeof(struct pblk));
+	p->w = calloc(nthreads, sizeof(struct bpool_worker));
+	if (!p->blk || !p->w || (hist > block))
+		goto fail;
+	for (size_t i = 0; i < p->nslots; i++) {
+		if (!(p->blk[i].in = malloc(hist + block)) || !(p->blk[i].out = malloc(out_cap)))
+			goto fail;
+	}
+	for (int i = 0; i < nthreads; i++) {
+		struct bpool_worker *w = &p->w[i];
+		w->p = p;
+		if (ctx_new && !(w->ctx = ctx_new(owner)))
+			goto fail;
+		if (pthread_create(&w->thread, NULL, bpool_worker, w))
+			goto fail;
+		w->running = 1;
+	}
+	return 0;
+
+fail:
+	perror("worker pool");
+	bpool_stop(p);
+	return -1;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCKPOOL_H
+#define BLOCKPOOL_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Worker pool for sinks that transform the stream in blocks (compression,
+ * DSP). The caller fills blocks through bpool_get()/bpool_put(), workers
+ * process them in parallel, and finished blocks are handed to store() in
+ * order on the caller's thread whenever it comes by - so only that thread
+ * ever touches the inner sink. Blocks are used as a ring, block k sits in
+ * slot k % nslots, which is free again once block k is stored.
+ *
+ * Every block's input starts with the last hist bytes of its predecessor
+ * (zeros for the first), for filters that need history.
+ */
+
+struct pblk {
+	uint8_t *in;           // hist bytes of the previous block, then len own bytes
+	size_t len;
+	uint8_t *out;
+	size_t out_len;
+	uint64_t seq;          // block number
+	_Atomic int state;
+};
+
+struct bpool_worker {
+	struct bpool *p;
+	void *ctx;
+	pthread_t thread;
+	int running;
+};
+
+struct bpool {
+	size_t block, hist, out_cap;
+	struct pblk *blk;
+	size_t nslots;
+	struct bpool_worker *w;
+	int nthreads;
+
+	void *owner;
+	void (*work)(void *owner, void *ctx, struct pblk *b);     // worker thread
+	int  (*store)(void *owner, struct pblk *b);               // caller's thread, in order
+	void (*ctx_free)(void *ctx);
+
+	_Atomic size_t queued;     // blocks handed to the workers
+	_Atomic size_t taken;      // blocks picked up by a worker
+	size_t stored;
+	struct pblk *cur;          // block being filled
+	_Atomic int stop;
+	int failed;
+};
+
+/* ctx_new: per worker state, may be NULL */
+int  bpool_start(struct bpool *p, size_t block, size_t hist, size_t out_cap, int nthreads, void *owner,
+	void *(*ctx_new)(void *owner), void (*ctx_free)(void *ctx),
+	void (*work)(void *owner, void *ctx, struct pblk *b), int (*store)(void *owner, struct pblk *b));
+
+/* *len: in = wanted, out = room left in the current block; stall_us: time spent waiting */
+int  bpool_get(struct bpool *p, void **dst, size_t *len, uint64_t *stall_us);
+int  bpool_put(struct bpool *p, size_t len);
+/* hands off the partial last block and waits until everything is stored */
+int  bpool_finish(struct bpool *p);
+void bpool_stop(struct bpool *p);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Channelizing sinks: run the captured stream through a PFB (see pfb.h)
+ * or the overlap-save extractor (see ols.h) on a worker pool and store
+ * every channel in a file of its own, named by a printf pattern with the
+ * channel number. Sizes and positions of these sinks count input bytes.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "storage.h"
+#include "blockpool.h"
+#include "pfb.h"
+#include "ols.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b)    ((a)>=(b)?(a):(b))
+#endif
+
+#define BLOCK_SAMPLES   (1 << 18)   // input samples per block, rounded up to the bank's granularity
+
+struct chans {
+	const struct pfb *pfb;      // one of these
+	const struct ols *ols;
+	struct bpool pool;
+	size_t ss;
+	size_t block;               // input samples
+	int n;
+	size_t *decim;              // per channel
+	size_t *ofs;                // where a channel's outputs start in a block's, samples
+	struct sink *out;           // one per channel
+	int nopen;
+	size_t *stored;
+	int failed;
+};
+
+static void *ch_ctx_new(void *owner) {
+	struct chans *ch = owner;
+	return ch->pfb ? pfb_scratch_new(ch->pfb, ch->block) : ols_scratch_new(ch->ols, ch->block);
+}
+
+static void ch_work(void *owner, void *ctx, struct pblk *b) {
+	struct chans *ch = owner;
+	size_t n = b->len / ch->ss;
+	if (ch->pfb)
+		pfb_run(ch->pfb, ctx, b->in, n, b->seq * ch->block, (int16_t *)b->out, ch->ofs[1]);
+	else
+		ols_run(ch->ols, ctx, b->in, n, b->seq * ch->block, (int16_t *)b->out, ch->ofs);
+}
+
+static int ch_store(void *owner, struct pblk *b) {
+	struct chans *ch = owner;
+	size_t n = b->len / ch->ss;
+	for (int i = 0; i < ch->nopen; i++) {
+		size_t len = (n + ch->decim[i] - 1) / ch->decim[i] * 4;
+		if (sink_copy(&ch->out[i], b->out + ch->ofs[i] * 4, len))
+			return -1;
+		*ch->stored += len;
+	}
+	return 0;
+}
+static int ch_get(struct sink *s, void **dst, size_t *len) {
+	struct chans *ch = s->priv;
+
+	*len = MIN(*len, s->size - s->written);
+	if (!*len)
+		return 0;
+	if (ch->failed || bpool_get(&ch->pool, dst, len, &s->stall_us)) {
+		ch->failed = 1;
+		return -1;
+	}
+	return 0;
+}
+
+static int ch_put(struct sink *s, size_t len) {
+	struct chans *ch = s->priv;
+	s->written += len;
+	return bpool_put(&ch->pool, len);
+}
+
+static int ch_flush(struct sink *s) {
+	struct chans *ch = s->priv;
+	int res = 0;
+	for (int i = 0; i < ch->nopen; i++)
+		res |= sink_flush(&ch->out[i]);
+	return res;
+}
+
+static void ch_close(struct sink *s) {
+	struct chans *ch = s->priv;
+
+	if (ch->pool.blk && !ch->failed && bpool_finish(&ch->pool))
+		fputs("channelizer: can't store the last block\n", stderr);
+	bpool_stop(&ch->pool);
+	for (int i = 0; i < ch->nopen; i++)
+		sink_close(&ch->out[i]);
+	free(ch->out);
+	free(ch->decim);
+	free(ch->ofs);
+	free(ch);
+}
+
+static const struct sink_ops ch_ops = {
+	.name  = "channels",
+	.get   = ch_get,
+	.put   = ch_put,
+	.flush = ch_flush,
+	.close = ch_close,
+};
+
+static struct chans *chans_new(struct sink *s, int n, size_t ss) {
+	struct chans *ch = calloc(1, sizeof(struct chans));
+
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &ch_ops;
+	s->ss = ss;
+	s->priv = ch;
+	if (!ch || !(ch->out = calloc(n, sizeof(struct sink))) ||
+			!(ch->decim = calloc(n, sizeof(size_t))) || !(ch->ofs = calloc(n + 1, sizeof(size_t)))) {
+		perror("channelizer");
+		if (ch)
+			ch_close(s);
+		return NULL;
+	}
+	ch->n = n;
+	ch->ss = ss;
+	return ch;
+}
+
+/* ch->decim set, blocks of a multiple of align samples */
+static int chans_open(struct sink *s, struct chans *ch, int backend, const char *pattern, size_t max_size,
+	const int *label, size_t hist, size_t align, int nthreads, void (*ctx_free)(void *ctx))
+{
+	size_t dmin = ch->decim[0];
+	char fn[PATH_MAX];
+
+	ch->block = (MAX(BLOCK_SAMPLES, hist) + align - 1) / align * align;
+	for (int i = 0; i < ch->n; i++) {
+		ch->ofs[i + 1] = ch->ofs[i] + ch->block / ch->decim[i];
+		dmin = MIN(dmin, ch->decim[i]);
+	}
+	// the widest channel fills its file first
+	s->size = max_size / 4 * dmin * ch->ss;
+
+	for (; ch->nopen < ch->n; ch->nopen++) {
+		snprintf(fn, sizeof(fn), pattern, label ? label[ch->nopen] : ch->nopen);
+		if (sink_open(&ch->out[ch->nopen], backend, fn, max_size, 0))
+			goto fail;
+		ch->out[ch->nopen].ss = 4;
+	}
+	if (bpool_start(&ch->pool, ch->block * ch->ss, hist * ch->ss, ch->ofs[ch->n] * 4, nthreads, ch,
+			ch_ctx_new, ctx_free, ch_work, ch_store))
+		goto fail;
+	return 0;
+
+fail:
+	ch->failed = 1;
+	ch_close(s);
+	return -1;
+}
+
+static void chans_sidecar(const char *pattern, const struct pfb *pfb, const struct ols *ols) {
+	char base[PATH_MAX];
+	FILE *fl;
+
+	segment_basename(base, sizeof(base), pattern);
+	if ((fl = sidecar_open(base, "channels"))) {
+		if (pfb)
+			pfb_describe(pfb, fl, pattern);
+		else
+			ols_describe(ols, fl, pattern);
+		fclose(fl);
+	}
+}
+
+/*
+ * pattern: printf pattern taking the channel number, max_size: per channel
+ * file, pfb has to outlive s, *stored counts the bytes in all files
+ */
+int sink_open_channels(struct sink *s, int backend, const char *pattern, size_t max_size,
+	const struct pfb *pfb, int nthreads, size_t *stored)
+{
+	struct chans *ch = chans_new(s, pfb->nsel, pfb->ss);
+
+	if (!ch)
+		return -1;
+	ch->pfb = pfb;
+	ch->stored = stored;
+	*stored = 0;
+	for (int i = 0; i < ch->n; i++)
+		ch->decim[i] = pfb->decim;
+	if (chans_open(s, ch, backend, pattern, max_size, pfb->sel, pfb->hist, pfb->decim, nthreads, pfb_scratch_free))
+		return -1;
+	chans_sidecar(pattern, pfb, NULL);
+	return 0;
+}
+
+/* the same for an overlap-save channel list, files numbered from 0 */
+int sink_open_extract(struct sink *s, int backend, const char *pattern, size_t max_size,
+	const struct ols *ols, int nthreads, size_t *stored)
+{
+	struct chans *ch = chans_new(s, ols->nch, ols->ss);
+
+	if (!ch)
+		return -1;
+	ch->ols = ols;
+	ch->stored = stored;
+	*stored = 0;
+	for (int i = 0; i < ch->n; i++)
+		ch->decim[i] = ols->ch[i].decim;
+	if (chans_open(s, ch, backend, pattern, max_size, NULL, ols->hist, ols->step, nthreads, ols_scratch_free))
+		return -1;
+	chans_sidecar(pattern, NULL, ols);
+	return 0;
+}
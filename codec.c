@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <zstd.h>
+#include <lz4.h>
+#include <lz4hc.h>
+
+#include "iqz.h"
+
+struct cctx {
+	void *state;
+	int level;
+};
+
+static struct cctx *cctx_new(void *state, int level) {
+	struct cctx *c = malloc(sizeof(struct cctx));
+	if (!c || !state) {
+		free(c);
+		return NULL;
+	}
+	c->state = state;
+	c->level = level;
+	return c;
+}
+
+/* zstd */
+
+static void *zstd_new(int level) {
+	return cctx_new(ZSTD_createCCtx(), level);
+}
+
+static void zstd_free(void *ctx) {
+	struct cctx *c = ctx;
+	ZSTD_freeCCtx(c->state);
+	free(c);
+}
+
+static size_t zstd_bound(size_t len) {
+	return ZSTD_compressBound(len);
+}
+
+static size_t zstd_compress(void *ctx, void *dst, size_t cap, const void *src, size_t len) {
+	struct cctx *c = ctx;
+	size_t n = ZSTD_compressCCtx(c->state, dst, cap, src, len, c->level);
+	return ZSTD_isError(n) ? 0 : n;
+}
+
+static int zstd_decompress(void *dst, size_t len, const void *src, size_t n) {
+	size_t res = ZSTD_decompress(dst, len, src, n);
+	return (ZSTD_isError(res) || (res != len)) ? -1 : 0;
+}
+
+/* lz4: level 1 is the fast compressor, higher levels use LZ4HC */
+
+static void *lz4_new(int level) {
+	return cctx_new(malloc((level > 1) ? LZ4_sizeofStateHC() : LZ4_sizeofState()), level);
+}
+
+static void lz4_free(void *ctx) {
+	struct cctx *c = ctx;
+	free(c->state);
+	free(c);
+}
+
+static size_t lz4_bound(size_t len) {
+	return LZ4_compressBound(len);
+}
+
+static size_t lz4_compress(void *ctx, void *dst, size_t cap, const void *src, size_t len) {
+	struct cctx *c = ctx;
+	int n = (c->level > 1) ?
+		LZ4_compress_HC_extStateHC(c->state, src, dst, len, cap, c->level) :
+		LZ4_compress_fast_extState(c->state, src, dst, len, cap, 1);
+	return (n > 0) ? (size_t)n : 0;
+}
+
+static int lz4_decompress(void *dst, size_t len, const void *src, size_t n) {
+	return (LZ4_decompress_safe(src, dst, n, len) == (int)len) ? 0 : -1;
+}
+
+static const struct codec zstd = { "zstd", CODEC_ZSTD, 1, zstd_new, zstd_free, zstd_bound, zstd_compress, zstd_decompress, 0, 0 };
+static const struct codec lz4  = { "lz4",  CODEC_LZ4,  1, lz4_new,  lz4_free,  lz4_bound,  lz4_compress,  lz4_decompress,  0, 0 };
+
+static const struct codec *codecs[] = { &zstd, &lz4, &codec_lpc, &codec_quant };
+
+#define NUM_CODECS  (sizeof(codecs) / sizeof(codecs[0]))
+
+const struct codec *codec_parse(const char *spec, int *level) {
+	const char *colon = strchr(spec, ':');
+	size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+	for (size_t i = 0; i < NUM_CODECS; i++) {
+		if (strlen(codecs[i]->name) == len && !strncmp(spec, codecs[i]->name, len)) {
+			*level = colon ? atoi(colon + 1) : codecs[i]->level;
+			return codecs[i];
+		}
+	}
+	return NULL;
+}
+
+const struct codec *codec_by_id(int id) {
+	for (size_t i = 0; i < NUM_CODECS; i++) {
+		if (codecs[i]->id == id)
+			return codecs[i];
+	}
+	return NULL;
+}
+
+const char *codec_names(void) {
+	static char names[64];
+	if (!names[0]) {
+		for (size_t i = 0; i < NUM_CODECS; i++)
+			snprintf(names + strlen(names), sizeof(names) - strlen(names), "%s%s", i ? ", " : "", codecs[i]->name);
+	}
+	return names;
+}
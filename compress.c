@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compressing sink, writes an iqz container (see iqz.h) into the inner
+ * sink. Blocks are compressed on a worker pool (see blockpool.h), the
+ * caller's thread stores them in order.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "storage.h"
+#include "blockpool.h"
+#include "iqz.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+struct comp {
+	struct sink *inner;
+	const struct codec *codec;
+	int level;
+	struct bpool pool;
+	int started;             // header written
+	uint64_t *index;
+	size_t index_cap;
+	size_t stored;           // blocks in the inner sink
+	_Atomic size_t raw_bytes, file_bytes;
+	int failed;
+};
+
+static void *comp_ctx_new(void *owner) {
+	struct comp *c = owner;
+	return c->codec->ctx_new(c->level);
+}
+
+/* worker thread, out_len 0: store raw */
+static void comp_work(void *owner, void *ctx, struct pblk *b) {
+	struct comp *c = owner;
+	b->out_len = c->codec->compress(ctx, b->out, c->pool.out_cap, b->in, b->len);
+	if (b->out_len >= b->len)
+		b->out_len = 0;
+}
+
+/* written on first use, a packing sink on top may have changed s->ss */
+static int comp_header(struct sink *s) {
+	struct comp *c = s->priv;
+	struct iqz_header hdr = {.magic = IQZ_MAGIC, .version = 1, .ss = s->ss, .block = IQZ_BLOCK};
+	if (c->started)
+		return 0;
+	c->started = 1;
+	return sink_copy(c->inner, &hdr, sizeof(hdr));
+}
+
+/* caller's thread, in order */
+static int comp_store(void *owner, struct pblk *b) {
+	struct comp *c = owner;
+	struct iqz_block bh = {
+		.len = b->out_len ? b->out_len : b->len,
+		.raw_len = b->len,
+		.codec = b->out_len ? c->codec->id : CODEC_RAW,
+	};
+	if (c->stored == c->index_cap) {
+		size_t cap = c->index_cap ? c->index_cap * 2 : 1024;
+		uint64_t *idx = realloc(c->index, cap * sizeof(uint64_t));
+		if (!idx)
+			return -1;
+		c->index = idx;
+		c->index_cap = cap;
+	}
+	c->index[c->stored] = c->inner->written;
+	if (sink_copy(c->inner, &bh, sizeof(bh)) || sink_copy(c->inner, b->out_len ? b->out : b->in, bh.len))
+		return -1;
+	atomic_fetch_add(&c->raw_bytes, b->len);
+	atomic_store(&c->file_bytes, c->inner->written);
+	c->stored++;
+	return 0;
+}
+
+static int comp_get(struct sink *s, void **dst, size_t *len) {
+	struct comp *c = s->priv;
+
+	*len = MIN(*len, s->size - s->written);
+	if (!*len)
+		return 0;
+	if (c->failed || comp_header(s) || bpool_get(&c->pool, dst, len, &s->stall_us)) {
+		c->failed = 1;
+		return -1;
+	}
+	return 0;
+}
+
+static int comp_put(struct sink *s, size_t len) {
+	struct comp *c = s->priv;
+	s->written += len;
+	return bpool_put(&c->pool, len);
+}
+
+/* the partial last block, then the index */
+static int comp_finish(struct sink *s) {
+	struct comp *c = s->priv;
+	struct iqz_tail tail = {.raw_size = s->written, .magic = IQZ_TAIL_MAGIC};
+
+	if (comp_header(s) || bpool_finish(&c->pool))
+		return -1;
+	tail.index = c->inner->written;
+	tail.blocks = c->stored;
+	if (sink_copy(c->inner, c->index, c->stored * sizeof(uint64_t)) || sink_copy(c->inner, &tail, sizeof(tail)))
+		return -1;
+	return 0;
+}
+
+static void comp_close(struct sink *s) {
+	struct comp *c = s->priv;
+
+	if (!c->failed && comp_finish(s))
+		fputs("compressed container: can't write the index\n", stderr);
+	bpool_stop(&c->pool);
+	sink_close(c->inner);
+	free(c->index);
+	free(c);
+}
+
+static const struct sink_ops comp_ops = {
+	.name  = "compressed",
+	.get   = comp_get,
+	.put   = comp_put,
+	.close = comp_close,
+};
+
+void sink_compress_stats(struct sink *s, size_t *raw, size_t *stored) {
+	struct comp *c = s->priv;
+	*raw = atomic_load(&c->raw_bytes);
+	*stored = atomic_load(&c->file_bytes);
+}
+
+/* inner: an open sink of at least iqz_bound(max_size) bytes, closed along with s */
+int sink_open_compressed(struct sink *s, struct sink *inner, size_t max_size,
+	const struct codec *codec, int level, int nthreads)
+{
+	struct comp *c = calloc(1, sizeof(struct comp));
+
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &comp_ops;
+	s->size = max_size;
+	s->ss = sink_sample_size;
+	s->priv = c;
+	if (!c) {
+		perror("compressor");
+		sink_close(inner);
+		return -1;
+	}
+	c->inner = inner;
+	c->codec = codec;
+	c->level = level;
+	if (bpool_start(&c->pool, IQZ_BLOCK, 0, codec->bound(IQZ_BLOCK), nthreads, c,
+			comp_ctx_new, codec->ctx_free, comp_work, comp_store)) {
+		sink_close(inner);
+		free(c);
+		return -1;
+	}
+	return 0;
+}
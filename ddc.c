@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ddc.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+struct ddc_scratch {
+	float *re[2], *im[2];
+};
+
+/* one stage from rate r down by f, passband edge fp (Hz) */
+static int ddc_stage(struct ddc_stage *st, double r, int f, double fp, double atten) {
+	double pass = fp / r, stop = (r / f - fp) / r;
+	int n = fir_kaiser_len(pass, stop, atten);
+	int padded = (n + DSP_ALIGN - 1) / DSP_ALIGN * DSP_ALIGN;
+	float h[n];
+
+	if (!(st->h = calloc(padded, sizeof(float))))
+		return -1;
+	fir_kaiser_lowpass(h, n, pass, stop, atten);
+	for (int k = 0; k < n; k++)
+		st->h[k] = h[n - 1 - k];
+	st->d = f;
+	st->taps = n;
+	return 0;
+}
+
+static long max_prime(long n) {
+	long best = 1;
+	for (long p = 2; p * p <= n; p++) {
+		for (; !(n % p); n /= p)
+			best = p;
+	}
+	return (n > 1) ? n : best;
+}
+
+int ddc_init(struct ddc *d, double rate, double offset, double out_rate, double pass, double atten, size_t ss) {
+	double r = rate, fp = pass * out_rate / 2;
+	long decim = lrint(rate / out_rate);
+	size_t step = 1;
+
+	memset(d, 0, sizeof(struct ddc));
+	d->rate = rate;
+	d->offset = offset;
+	d->out_rate = out_rate;
+	d->pass = pass;
+	d->atten = atten;
+	d->ss = ss;
+	if ((out_rate <= 0) || (decim < 1) || (fabs(decim * out_rate - rate) > 1e-6 * rate)) {
+		fprintf(stderr, "DDC: output rate must be the input rate divided by an integer\n");
+		return -1;
+	}
+	if ((pass <= 0) || (pass >= 1) || (atten < 20)) {
+		fprintf(stderr, "DDC: passband must be between 0 and 1, stopband at least 20 dB\n");
+		return -1;
+	}
+	if (fabs(offset) + fp > rate / 2) {
+		fprintf(stderr, "DDC: channel at %.0f Hz is outside the captured band\n", offset);
+		return -1;
+	}
+	d->decim = decim;
+
+	// prime factors, biggest first
+	for (long rest = decim; rest > 1; ) {
+		long f = max_prime(rest);
+		if (d->nstages == DDC_MAX_STAGES) {
+			fprintf(stderr, "DDC: decimation by %ld needs too many stages\n", decim);
+			ddc_free(d);
+			return -1;
+		}
+		if (ddc_stage(&d->st[d->nstages], r, f, fp, atten)) {
+			perror("DDC");
+			ddc_free(d);
+			return -1;
+		}
+		d->span += (d->st[d->nstages].taps - 1) * step;
+		d->nstages++;
+		step *= f;
+		r /= f;
+		rest /= f;
+	}
+	d->hist = (d->span + decim - 1) / decim * decim;
+	nco_init(&d->nco, -offset, rate);
+	return 0;
+}
+
+/* <offset>:<rate>[:<passband>[:<dB>]] */
+int ddc_parse(struct ddc *d, const char *spec, double rate, size_t ss) {
+	double offset, out_rate, pass = 0.8, atten = 80;
+	char *end;
+
+	offset = parse_freq(spec, &end);
+	if (*end != ':')
+		goto fail;
+	out_rate = parse_freq(end + 1, &end);
+	if (*end == ':')
+		pass = strtod(end + 1, &end);
+	if (*end == ':')
+		atten = strtod(end + 1, &end);
+	if (*end)
+		goto fail;
+	return ddc_init(d, rate, offset, out_rate, pass, atten, ss);
+fail:
+	fprintf(stderr, "DDC: bad spec %s\n", spec);
+	return -1;
+}
+
+void ddc_free(struct ddc *d) {
+	for (int i = 0; i < d->nstages; i++)
+		free(d->st[i].h);
+	d->nstages = 0;
+}
+
+void *ddc_scratch_new(const struct ddc *d, size_t len) {
+	struct ddc_scratch *sc = calloc(1, sizeof(struct ddc_scratch));
+	size_t n = d->hist + len + DSP_ALIGN;
+	if (!sc)
+		return NULL;
+	for (int i = 0; i < 2; i++) {
+		// zeroed, so the padding the FIR reads past the end is finite
+		if (!(sc->re[i] = calloc(n, sizeof(float))) || !(sc->im[i] = calloc(n, sizeof(float)))) {
+			ddc_scratch_free(sc);
+			return NULL;
+		}
+	}
+	return sc;
+}
+
+void ddc_scratch_free(void *scratch) {
+	struct ddc_scratch *sc = scratch;
+	for (int i = 0; i < 2; i++) {
+		free(sc->re[i]);
+		free(sc->im[i]);
+	}
+	free(sc);
+}
+
+size_t ddc_run(const struct ddc *d, void *scratch, const void *in, size_t len, uint64_t start, int16_t *out) {
+	struct ddc_scratch *sc = scratch;
+	size_t n = d->hist + len, j0, end;
+	int cur = 0;
+
+	iq_to_float(sc->re[0], sc->im[0], in, n, d->ss);
+	nco_mix(&d->nco, sc->re[0], sc->im[0], n, start - d->hist);
+	for (int i = 0; i < d->nstages; i++, cur ^= 1) {
+		const struct ddc_stage *st = &d->st[i];
+		n = fir_decimate(sc->re[!cur], sc->im[!cur], sc->re[cur], sc->im[cur], n, st->h, st->taps, st->d);
+	}
+	// output j belongs to input sample start - hist + span + j * decim, keep the new ones
+	j0 = (d->hist - d->span + d->decim - 1) / d->decim;
+	end = (d->hist + len - d->span + d->decim - 1) / d->decim;
+	end = MIN(end, n);
+	if (end <= j0)
+		return 0;
+	float_to_sc16(out, sc->re[cur] + j0, sc->im[cur] + j0, end - j0);
+	return end - j0;
+}
+
+size_t ddc_first(const struct ddc *d) {
+	size_t j0 = (d->hist - d->span + d->decim - 1) / d->decim;
+	return d->span + j0 * d->decim - d->hist;
+}
+
+double ddc_delay(const struct ddc *d) {
+	// linear phase stages: half their span each
+	return d->span / 2.0;
+}
+
+void ddc_describe(const struct ddc *d, FILE *fl) {
+	double r = d->rate;
+
+	fprintf(fl, "# SC16 at out_rate, input full scale = 32767, centered on the offset\n");
+	fprintf(fl, "# output sample m is input sample first + m * decimation - delay\n");
+	fprintf(fl, "in_rate %.0f\n", d->rate);
+	fprintf(fl, "out_rate %.0f\n", d->out_rate);
+	fprintf(fl, "offset %.0f\n", d->offset);
+	fprintf(fl, "decimation %d\n", d->decim);
+	fprintf(fl, "passband %.0f\n", d->pass * d->out_rate / 2);
+	fprintf(fl, "stopband_db %.1f\n", d->atten);
+	fprintf(fl, "first %zu\n", ddc_first(d));
+	fprintf(fl, "delay %.1f\n", ddc_delay(d));
+	for (int i = 0; i < d->nstages; i++) {
+		fprintf(fl, "stage %d decimation %d taps %d rate %.0f kaiser\n", i, d->st[i].d, d->st[i].taps, r);
+		r /= d->st[i].d;
+	}
+}
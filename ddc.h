@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DDC_H
+#define DDC_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsp.h"
+
+/*
+ * Digital downconverter: shifts offset Hz to 0 with an NCO, then
+ * decimates by rate / out_rate in a cascade of FIR stages, one per prime
+ * factor, biggest first. Every stage only has to keep its own output from
+ * aliasing into the final passband (pass * out_rate / 2), so the early
+ * ones are short. Output is SC16 with input full scale at 32767, the gain
+ * of the decimation shows up as extra resolution.
+ *
+ * Blocks can be run independently and in any order: a block of len new
+ * samples starting at input sample start (a multiple of decim) comes with
+ * hist samples of history in front and yields the outputs that belong to
+ * its new samples, the same a single continuous run would give.
+ */
+
+#define DDC_MAX_STAGES  16
+
+struct ddc_stage {
+	int d, taps;
+	float *h;               // reversed, padded to DSP_ALIGN
+};
+
+struct ddc {
+	double rate, offset, out_rate, pass, atten;
+	size_t ss;              // input sample size, 2 or 4
+	int decim;
+	int nstages;
+	struct ddc_stage st[DDC_MAX_STAGES];
+	struct nco nco;
+	size_t span;            // input samples under one output, minus one
+	size_t hist;            // history in front of a block, multiple of decim
+};
+
+/* pass: passband as a fraction of the output bandwidth, atten: stopband dB */
+int  ddc_init(struct ddc *d, double rate, double offset, double out_rate, double pass, double atten, size_t ss);
+/* from <offset>:<out_rate>[:<pass>[:<atten>]], k/M suffixes, pass 0.8 and 80 dB by default */
+int  ddc_parse(struct ddc *d, const char *spec, double rate, size_t ss);
+void ddc_free(struct ddc *d);
+
+/* per thread scratch for blocks of up to len new samples */
+void *ddc_scratch_new(const struct ddc *d, size_t len);
+void ddc_scratch_free(void *scratch);
+
+/* in: hist + len samples, returns the number of SC16 samples in out */
+size_t ddc_run(const struct ddc *d, void *scratch, const void *in, size_t len, uint64_t start, int16_t *out);
+
+/* first input sample an output belongs to, group delay in input samples */
+size_t ddc_first(const struct ddc *d);
+double ddc_delay(const struct ddc *d);
+
+/* key value lines for a metadata sidecar */
+void ddc_describe(const struct ddc *d, FILE *fl);
+
+#endif
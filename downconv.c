@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Downconverting and resampling sinks: run the stream through a DDC (see
+ * ddc.h) or a resampler (see resamp.h) on a worker pool and store only the
+ * SC16 output in the inner sink. Sizes and positions of these sinks count
+ * input bytes, the inner one's output bytes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "storage.h"
+#include "blockpool.h"
+#include "ddc.h"
+#include "resamp.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define BLOCK_SAMPLES   (1 << 18)   // input samples per block, DDC: rounded up to the decimation
+
+struct downconv {
+	struct sink *inner;
+	const struct ddc *ddc;      // one of these
+	const struct resamp *rs;
+	struct bpool pool;
+	size_t ss;
+	size_t block;               // input samples
+	int failed;
+};
+
+static void *dc_ctx_new(void *owner) {
+	struct downconv *dc = owner;
+	return dc->ddc ? ddc_scratch_new(dc->ddc, dc->block) : resamp_scratch_new(dc->rs, dc->block);
+}
+
+static void dc_work(void *owner, void *ctx, struct pblk *b) {
+	struct downconv *dc = owner;
+	size_t n = b->len / dc->ss, start = b->seq * dc->block;
+	if (dc->ddc)
+		n = ddc_run(dc->ddc, ctx, b->in, n, start, (int16_t *)b->out);
+	else
+		n = resamp_run(dc->rs, ctx, b->in, n, start, (int16_t *)b->out);
+	b->out_len = n * 4;
+}
+
+static int dc_store(void *owner, struct pblk *b) {
+	struct downconv *dc = owner;
+	return sink_copy(dc->inner, b->out, b->out_len);
+}
+
+static int dc_get(struct sink *s, void **dst, size_t *len) {
+	struct downconv *dc = s->priv;
+
+	*len = MIN(*len, s->size - s->written);
+	if (!*len)
+		return 0;
+	if (dc->failed || bpool_get(&dc->pool, dst, len, &s->stall_us)) {
+		dc->failed = 1;
+		return -1;
+	}
+	return 0;
+}
+
+static int dc_put(struct sink *s, size_t len) {
+	struct downconv *dc = s->priv;
+	s->written += len;
+	return bpool_put(&dc->pool, len);
+}
+
+static int dc_flush(struct sink *s) {
+	struct downconv *dc = s->priv;
+	return sink_flush(dc->inner);
+}
+
+static void dc_close(struct sink *s) {
+	struct downconv *dc = s->priv;
+
+	if (!dc->failed && bpool_finish(&dc->pool))
+		fputs("downconverter: can't store the last block\n", stderr);
+	bpool_stop(&dc->pool);
+	sink_close(dc->inner);
+	free(dc);
+}
+
+static const struct sink_ops dc_ops = {
+	.name  = "ddc",
+	.get   = dc_get,
+	.put   = dc_put,
+	.flush = dc_flush,
+	.close = dc_close,
+};
+
+static const struct sink_ops rs_ops = {
+	.name  = "resampler",
+	.get   = dc_get,
+	.put   = dc_put,
+	.flush = dc_flush,
+	.close = dc_close,
+};
+
+/* inner: an open sink, closed along with s; ddc has to outlive s */
+int sink_open_downconv(struct sink *s, struct sink *inner, const struct ddc *ddc, int nthreads) {
+	struct downconv *dc = calloc(1, sizeof(struct downconv));
+	size_t block = (BLOCK_SAMPLES + ddc->decim - 1) / ddc->decim * ddc->decim;
+
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &dc_ops;
+	// at most one output per decim inputs
+	s->size = inner->size / 4 * ddc->decim * ddc->ss;
+	s->ss = ddc->ss;
+	s->priv = dc;
+	if (!dc) {
+		perror("downconverter");
+		sink_close(inner);
+		return -1;
+	}
+	dc->inner = inner;
+	dc->ddc = ddc;
+	dc->ss = ddc->ss;
+	dc->block = (block < ddc->hist) ? ddc->hist : block;
+	inner->ss = 4;
+	if (bpool_start(&dc->pool, dc->block * ddc->ss, ddc->hist * ddc->ss, (dc->block / ddc->decim + 1) * 4, nthreads, dc,
+			dc_ctx_new, ddc_scratch_free, dc_work, dc_store)) {
+		sink_close(inner);
+		free(dc);
+		return -1;
+	}
+	return 0;
+}
+
+/* the same through a resampler, rs has to outlive s */
+int sink_open_resample(struct sink *s, struct sink *inner, const struct resamp *rs, int nthreads) {
+	struct downconv *dc = calloc(1, sizeof(struct downconv));
+
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &rs_ops;
+	// m / l inputs per output
+	s->size = (size_t)((double)(inner->size / 4) * rs->m / rs->l) * rs->ss;
+	s->ss = rs->ss;
+	s->priv = dc;
+	if (!dc) {
+		perror("resampler");
+		sink_close(inner);
+		return -1;
+	}
+	dc->inner = inner;
+	dc->rs = rs;
+	dc->ss = rs->ss;
+	dc->block = (BLOCK_SAMPLES < rs->hist) ? rs->hist : BLOCK_SAMPLES;
+	inner->ss = 4;
+	if (bpool_start(&dc->pool, dc->block * rs->ss, rs->hist * rs->ss, (dc->block * rs->l / rs->m + 1) * 4, nthreads, dc,
+			dc_ctx_new, resamp_scratch_free, dc_work, dc_store)) {
+		sink_close(inner);
+		free(dc);
+		return -1;
+	}
+	return 0;
+}
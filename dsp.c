@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dsp.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+/*
+ * Inner loops use vector types like lpc.c, so they vectorize at -O2 and
+ * get an AVX2 build picked at load time on x86.
+ */
+typedef float v8sf __attribute__((vector_size(32)));
+
+#if defined(__x86_64__)
+#define MULTIVERSION    __attribute__((target_clones("avx2", "default")))
+#else
+#define MULTIVERSION
+#endif
+
+/* Hz, k and M suffixes, end: past the number and suffix */
+double parse_freq(const char *arg, char **end) {
+	double f = strtod(arg, end);
+	if (**end == 'k')
+		f *= 1e3, (*end)++;
+	else if (**end == 'M')
+		f *= 1e6, (*end)++;
+	return f;
+}
+
+/* filter design */
+
+static double bessel_i0(double x) {
+	double sum = 1, term = 1;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+static double kaiser_beta(double atten) {
+	if (atten > 50)
+		return 0.1102 * (atten - 8.7);
+	if (atten > 21)
+		return 0.5842 * pow(atten - 21, 0.4) + 0.07886 * (atten - 21);
+	return 0;
+}
+
+int fir_kaiser_len(double pass, double stop, double atten) {
+	int n = ceil((atten - 7.95) / (14.36 * (stop - pass))) + 1;
+	return (n < 3) ? 3 : n;
+}
+
+void fir_kaiser_lowpass(float *h, int n, double pass, double stop, double atten) {
+	double fc = (pass + stop) / 2, beta = kaiser_beta(atten), i0b = bessel_i0(beta), sum = 0;
+
+	for (int k = 0; k < n; k++) {
+		double t = k - (n - 1) / 2.0, r = 2.0 * k / (n - 1) - 1;
+		double sinc = t ? sin(2 * M_PI * fc * t) / (M_PI * t) : 2 * fc;
+		double v = sinc * bessel_i0(beta * sqrt(fmax(0, 1 - r * r))) / i0b;
+		h[k] = v;
+		sum += v;
+	}
+	for (int k = 0; k < n; k++)
+		h[k] /= sum;
+}
+
+/* NCO */
+
+uint64_t nco_step(double freq, double rate) {
+	double f = freq / rate;
+	f -= round(f);
+	// f * 2^64, in two steps so +-0.5 turns don't overflow
+	return (uint64_t)llround(f * 9223372036854775808.0) * 2;
+}
+
+static void nco_rot(uint64_t phase, double *c, double *s) {
+	double a = (double)(int64_t)phase * (M_PI / 9223372036854775808.0);
+	*c = cos(a);
+	*s = sin(a);
+}
+
+void nco_init(struct nco *o, double freq, double rate) {
+	o->step = nco_step(freq, rate);
+	for (int i = 0; i < NCO_SEG; i++) {
+		double c, s;
+		nco_rot(o->step * i, &c, &s);
+		o->re[i] = c;
+		o->im[i] = s;
+	}
+}
+
+MULTIVERSION
+void nco_mix(const struct nco *o, float *re, float *im, size_t n, uint64_t start) {
+	// segments on multiples of NCO_SEG, so every sample gets the same factor wherever a block starts
+	for (size_t ofs = 0, m; ofs < n; ofs += m) {
+		uint64_t pos = start + ofs;
+		size_t i0 = pos % NCO_SEG;
+		double c, s;
+		m = MIN(NCO_SEG - i0, n - ofs);
+		nco_rot((pos - i0) * o->step, &c, &s);
+		float rc = c, rs = s, *xr = re + ofs - i0, *xi = im + ofs - i0;
+		for (size_t i = i0; i < i0 + m; i++) {
+			float wr = rc * o->re[i] - rs * o->im[i];
+			float wi = rc * o->im[i] + rs * o->re[i];
+			float r = xr[i] * wr - xi[i] * wi;
+			xi[i] = xr[i] * wi + xi[i] * wr;
+			xr[i] = r;
+		}
+	}
+}
+
+/* conversion */
+
+MULTIVERSION
+void iq_to_float(float *re, float *im, const void *iq, size_t n, size_t ss) {
+	if (ss == 2) {
+		const int8_t *p = iq;
+		for (size_t i = 0; i < n; i++) {
+			re[i] = p[2 * i] * (1.0f / 128);
+			im[i] = p[2 * i + 1] * (1.0f / 128);
+		}
+	}
+	else {
+		const int16_t *p = iq;
+		for (size_t i = 0; i < n; i++) {
+			re[i] = p[2 * i] * (1.0f / 2048);
+			im[i] = p[2 * i + 1] * (1.0f / 2048);
+		}
+	}
+}
+
+static inline int16_t sat16(float x) {
+	x *= 32767;
+	x = (x > 32767) ? 32767 : (x < -32767) ? -32767 : x;
+	return (int16_t)(x + ((x < 0) ? -0.5f : 0.5f));
+}
+
+MULTIVERSION
+void float_to_sc16(int16_t *iq, const float *re, const float *im, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		iq[2 * i] = sat16(re[i]);
+		iq[2 * i + 1] = sat16(im[i]);
+	}
+}
+
+/* FFT */
+
+int fft_init(struct fft *f, int n) {
+	memset(f, 0, sizeof(struct fft));
+	if ((n < 2) || (n & (n - 1)))
+		return -1;
+	f->n = n;
+	f->tw_re = malloc(n * sizeof(float));
+	f->tw_im = malloc(n * sizeof(float));
+	f->tx_re = malloc(n * sizeof(float));
+	f->tx_im = malloc(n * sizeof(float));
+	f->wr = malloc(n * sizeof(float));
+	f->wi = malloc(n * sizeof(float));
+	if (!f->tw_re || !f->tw_im || !f->tx_re || !f->tx_im || !f->wr || !f->wi) {
+		fft_free(f);
+		return -1;
+	}
+	for (int l = 1; l < n; l *= 2) {
+		for (int j = 0; j < l; j++) {
+			f->tw_re[l - 1 + j] = cos(M_PI * j / l);
+			f->tw_im[l - 1 + j] = -sin(M_PI * j / l);
+		}
+	}
+	// strides 2 and 4 have a twiddle per element
+	for (int i = 0; i < n / 2; i++) {
+		f->tx_re[i] = f->tw_re[n / 4 - 1 + i / 2];
+		f->tx_im[i] = f->tw_im[n / 4 - 1 + i / 2];
+		f->tx_re[n / 2 + i] = (n >= 8) ? f->tw_re[n / 8 - 1 + i / 4] : 0;
+		f->tx_im[n / 2 + i] = (n >= 8) ? f->tw_im[n / 8 - 1 + i / 4] : 0;
+	}
+	return 0;
+}
+
+void fft_free(struct fft *f) {
+	free(f->tw_re);
+	free(f->tw_im);
+	free(f->tx_re);
+	free(f->tx_im);
+	free(f->wr);
+	free(f->wi);
+	memset(f, 0, sizeof(struct fft));
+}
+
+typedef int v8si __attribute__((vector_size(32)));
+
+/* outputs of a stride m < 8 stage come as m sums, m differences, m sums, ... */
+static const v8si fft_lo[3] = { {0, 8, 1, 9, 2, 10, 3, 11}, {0, 1, 8, 9, 2, 3, 10, 11}, {0, 1, 2, 3, 8, 9, 10, 11} };
+static const v8si fft_hi[3] = { {4, 12, 5, 13, 6, 14, 7, 15}, {4, 5, 12, 13, 6, 7, 14, 15}, {4, 5, 6, 7, 12, 13, 14, 15} };
+
+MULTIVERSION
+void fft_run(struct fft *f, float *re, float *im, int inverse) {
+	float *xr = re, *xi = im, *yr = f->wr, *yi = f->wi, *t;
+	float sign = inverse ? -1 : 1;
+	int n = f->n, h = n / 2;
+
+	// l butterflies of stride m per stage, n = 2 * l * m
+	for (int l = n / 2, m = 1; l >= 1; l /= 2, m *= 2) {
+		const float *twr = f->tw_re + l - 1, *twi = f->tw_im + l - 1;
+		if (n < 16) {
+			// less than a vector per half
+			for (int j = 0; j < l; j++) {
+				for (int k = 0; k < m; k++) {
+					int a = j * m + k, b = a + h, s = a + j * m;
+					float ur = xr[a] - xr[b], ui = xi[a] - xi[b], wr = twr[j], wi = sign * twi[j];
+					yr[s] = xr[a] + xr[b];
+					yi[s] = xi[a] + xi[b];
+					yr[s + m] = ur * wr - ui * wi;
+					yi[s + m] = ur * wi + ui * wr;
+				}
+			}
+		}
+		else if (m < 8) {
+			// element a = j * m + k pairs with a + n / 2, 8 of them are 8 / m butterflies
+			const float *twr8 = (m == 1) ? twr : f->tx_re + (m >> 2) * h;
+			const float *twi8 = (m == 1) ? twi : f->tx_im + (m >> 2) * h;
+			v8si lo = fft_lo[m >> 1], hi = fft_hi[m >> 1];
+			for (int a = 0; a < h; a += 8) {
+				v8sf ar, ai, br, bi, wr, wi, ur, ui, v;
+				memcpy(&ar, xr + a, sizeof(ar));
+				memcpy(&ai, xi + a, sizeof(ai));
+				memcpy(&br, xr + a + h, sizeof(br));
+				memcpy(&bi, xi + a + h, sizeof(bi));
+				memcpy(&wr, twr8 + a, sizeof(wr));
+				memcpy(&wi, twi8 + a, sizeof(wi));
+				wi *= sign;
+				ur = ar - br;
+				ui = ai - bi;
+				ar += br;
+				ai += bi;
+				br = ur * wr - ui * wi;
+				bi = ur * wi + ui * wr;
+				v = __builtin_shuffle(ar, br, lo);
+				memcpy(yr + 2 * a, &v, sizeof(v));
+				v = __builtin_shuffle(ar, br, hi);
+				memcpy(yr + 2 * a + 8, &v, sizeof(v));
+				v = __builtin_shuffle(ai, bi, lo);
+				memcpy(yi + 2 * a, &v, sizeof(v));
+				v = __builtin_shuffle(ai, bi, hi);
+				memcpy(yi + 2 * a + 8, &v, sizeof(v));
+			}
+		}
+		else {
+			for (int j = 0; j < l; j++) {
+				float wr = twr[j], wi = sign * twi[j];
+				const float *ar = xr + j * m, *ai = xi + j * m;
+				float *sr = yr + 2 * j * m, *si = yi + 2 * j * m;
+				for (int k = 0; k < m; k += 8) {
+					v8sf pr, pi, qr, qi, ur, ui;
+					memcpy(&pr, ar + k, sizeof(pr));
+					memcpy(&pi, ai + k, sizeof(pi));
+					memcpy(&qr, ar + h + k, sizeof(qr));
+					memcpy(&qi, ai + h + k, sizeof(qi));
+					ur = pr - qr;
+					ui = pi - qi;
+					pr += qr;
+					pi += qi;
+					qr = ur * wr - ui * wi;
+					qi = ur * wi + ui * wr;
+					memcpy(sr + k, &pr, sizeof(pr));
+					memcpy(si + k, &pi, sizeof(pi));
+					memcpy(sr + m + k, &qr, sizeof(qr));
+					memcpy(si + m + k, &qi, sizeof(qi));
+				}
+			}
+		}
+		t = xr, xr = yr, yr = t;
+		t = xi, xi = yi, yi = t;
+	}
+	if (xr != re) {
+		memcpy(re, xr, n * sizeof(float));
+		memcpy(im, xi, n * sizeof(float));
+	}
+}
+
+/* decimating FIR, polyphase in effect: only the kept outputs are computed */
+
+MULTIVERSION
+size_t fir_decimate(float *yr, float *yi, const float *xr, const float *xi, size_t n,
+	const float *h, int taps, int d)
+{
+	int padded = (taps + DSP_ALIGN - 1) / DSP_ALIGN * DSP_ALIGN;
+	size_t out = (n >= (size_t)taps) ? (n - taps) / d + 1 : 0;
+
+	for (size_t j = 0; j < out; j++) {
+		const float *pr = xr + j * d, *pi = xi + j * d;
+		v8sf ar = {0}, ai = {0}, c, v;
+		for (int k = 0; k < padded; k += 8) {
+			memcpy(&c, h + k, sizeof(c));
+			memcpy(&v, pr + k, sizeof(v));
+			ar += c * v;
+			memcpy(&v, pi + k, sizeof(v));
+			ai += c * v;
+		}
+		yr[j] = ((ar[0] + ar[4]) + (ar[1] + ar[5])) + ((ar[2] + ar[6]) + (ar[3] + ar[7]));
+		yi[j] = ((ai[0] + ai[4]) + (ai[1] + ai[5])) + ((ai[2] + ai[6]) + (ai[3] + ai[7]));
+	}
+	return out;
+}
+
+MULTIVERSION
+void fir_resample(float *yr, float *yi, const float *xr, const float *xi, size_t n,
+	const float *h, int taps, int l, int m, int p)
+{
+	size_t pos = 0;
+
+	for (size_t j = 0; j < n; j++) {
+		const float *pr = xr + pos, *pi = xi + pos, *row = h + (size_t)p * taps;
+		v8sf ar = {0}, ai = {0}, c, v;
+		for (int k = 0; k < taps; k += 8) {
+			memcpy(&c, row + k, sizeof(c));
+			memcpy(&v, pr + k, sizeof(v));
+			ar += c * v;
+			memcpy(&v, pi + k, sizeof(v));
+			ai += c * v;
+		}
+		yr[j] = ((ar[0] + ar[4]) + (ar[1] + ar[5])) + ((ar[2] + ar[6]) + (ar[3] + ar[7]));
+		yi[j] = ((ai[0] + ai[4]) + (ai[1] + ai[5])) + ((ai[2] + ai[6]) + (ai[3] + ai[7]));
+		p += m;
+		pos += p / l;
+		p %= l;
+	}
+}
+
+MULTIVERSION
+void fir_fold(float *wr, float *wi, const float *xr, const float *xi, const float *h, int m, int rows) {
+	for (int p = 0; p < m; p += 8) {
+		v8sf ar = {0}, ai = {0}, c, v;
+		for (int t = 0; t < rows; t++) {
+			size_t i = p + (size_t)t * m;
+			memcpy(&c, h + i, sizeof(c));
+			memcpy(&v, xr + i, sizeof(v));
+			ar += c * v;
+			memcpy(&v, xi + i, sizeof(v));
+			ai += c * v;
+		}
+		memcpy(wr + p, &ar, sizeof(ar));
+		memcpy(wi + p, &ai, sizeof(ai));
+	}
+}
+
+MULTIVERSION
+void win_apply(float *re, float *im, const float *w, int n) {
+	for (int i = 0; i < n; i += 8) {
+		v8sf c, v;
+		memcpy(&c, w + i, sizeof(c));
+		memcpy(&v, re + i, sizeof(v));
+		v *= c;
+		memcpy(re + i, &v, sizeof(v));
+		memcpy(&v, im + i, sizeof(v));
+		v *= c;
+		memcpy(im + i, &v, sizeof(v));
+	}
+}
+
+MULTIVERSION
+void power_accum(float *sum, float *peak, const float *re, const float *im, int n) {
+	for (int i = 0; i < n; i += 8) {
+		v8sf r, q, s, m;
+		memcpy(&r, re + i, sizeof(r));
+		memcpy(&q, im + i, sizeof(q));
+		r = r * r + q * q;
+		memcpy(&s, sum + i, sizeof(s));
+		s += r;
+		memcpy(sum + i, &s, sizeof(s));
+		// no ?: on vectors in C, select through the compare mask
+		memcpy(&m, peak + i, sizeof(m));
+		v8si gt = r > m;
+		m = (v8sf)(((v8si)r & gt) | ((v8si)m & ~gt));
+		memcpy(peak + i, &m, sizeof(m));
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DSP_H
+#define DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Float building blocks for the DSP stages. Signals are kept planar
+ * (separate I and Q arrays) so the kernels vectorize.
+ */
+
+#define DSP_ALIGN   8           // FIR lengths are padded to this many taps
+
+/* Hz with an optional k or M suffix, end: past the number and suffix */
+double parse_freq(const char *arg, char **end);
+
+/* Kaiser window FIR: taps needed for a transition from pass to stop
+ * (fractions of the sample rate) with atten dB stopband attenuation */
+int  fir_kaiser_len(double pass, double stop, double atten);
+/* lowpass with unity DC gain, cutoff midway between pass and stop */
+void fir_kaiser_lowpass(float *h, int n, double pass, double stop, double atten);
+
+/* NCO: the phase is a 64 bit fraction of a turn, so it is exact for any
+ * sample index and the same no matter where a block starts */
+uint64_t nco_step(double freq, double rate);
+
+#define NCO_SEG     1024
+
+struct nco {
+	uint64_t step;
+	float re[NCO_SEG], im[NCO_SEG];     // exp(j * i * step)
+};
+
+void nco_init(struct nco *o, double freq, double rate);
+/* x *= exp(j * (start + i) * step), in place */
+void nco_mix(const struct nco *o, float *re, float *im, size_t n, uint64_t start);
+
+/* SC16 Q11 / SC8 Q7 to float, full scale = 1 */
+void iq_to_float(float *re, float *im, const void *iq, size_t n, size_t ss);
+/* float to SC16, full scale = 32767, saturating */
+void float_to_sc16(int16_t *iq, const float *re, const float *im, size_t n);
+
+/*
+ * Complex FFT of a power of 2 size, planar, unscaled, in natural order.
+ * Radix 2 Stockham, so there is no bit reversal pass and every stage
+ * runs over contiguous data, 8 floats at a time from 16 points up.
+ */
+struct fft {
+	int n;
+	float *tw_re, *tw_im;       // stage with l butterflies: exp(-j pi i / l) at l - 1 + i
+	float *tx_re, *tx_im;       // the same per element for strides 2 and 4
+	float *wr, *wi;             // scratch, n each
+};
+
+int  fft_init(struct fft *f, int n);
+void fft_free(struct fft *f);
+/* inverse: exp(+j ...), in place; not thread safe, one struct fft per thread */
+void fft_run(struct fft *f, float *re, float *im, int inverse);
+
+/*
+ * Decimating FIR: y[j] = sum h[k] * x[j * d + k], for the j whose taps fit
+ * in the n input samples, returns the number of outputs. h is in reverse
+ * order and padded with zeros to a multiple of DSP_ALIGN taps, x must be
+ * readable (and finite) that far past n.
+ */
+size_t fir_decimate(float *yr, float *yi, const float *xr, const float *xi, size_t n,
+	const float *h, int taps, int d);
+
+/*
+ * Rational resampling: output j is row p of h (l rows of taps, each
+ * reversed, taps a multiple of DSP_ALIGN) against x[pos .. pos + taps),
+ * then p += m, pos += p / l, p %= l; starting at pos 0 and the given p.
+ */
+void fir_resample(float *yr, float *yi, const float *xr, const float *xi, size_t n,
+	const float *h, int taps, int l, int m, int p);
+
+/* polyphase fold: w[p] = sum h[p + t * m] * x[p + t * m], t < rows, m a multiple of 8 */
+void fir_fold(float *wr, float *wi, const float *xr, const float *xi, const float *h, int m, int rows);
+
+/* x *= w, n a multiple of 8 */
+void win_apply(float *re, float *im, const float *w, int n);
+/* sum += |x|^2, peak = max(peak, |x|^2), n a multiple of 8 */
+void power_accum(float *sum, float *peak, const float *re, const float *im, int n);
+
+#endif
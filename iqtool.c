@@ -0,0 +1,1192 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Companion tool for captures written by bladerf_rx: converts the
+ * compact formats back to plain SC16 and benchmarks the kernels.
+ */
+
+#define _FILE_OFFSET_BITS 64
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "pack12.h"
+#include "iqz.h"
+#include "ddc.h"
+#include "pfb.h"
+#include "ols.h"
+#include "resamp.h"
+#include "spectro.h"
+#include "pyramid.h"
+
+#define MAX_SAMPLERATE  61440000    // SC16 on bladeRF 2.0
+#define CHUNK           (1 << 20)   // samples per read
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b)    ((a)>=(b)?(a):(b))
+#endif
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static FILE *open_or_die(const char *fn, const char *mode) {
+	FILE *fl = strcmp(fn, "-") ? fopen(fn, mode) : (*mode == 'r') ? stdin : stdout;
+	if (!fl) {
+		perror(fn);
+		exit(1);
+	}
+	return fl;
+}
+
+/* packed12 -> SC16 */
+static int cmd_unpack(int argc, char **argv) {
+	if (argc != 3) {
+		fputs("usage: iqtool unpack <in.p12|-> <out.iq|->\n", stderr);
+		return 1;
+	}
+	FILE *in = open_or_die(argv[1], "rb"), *out = open_or_die(argv[2], "wb");
+	uint8_t *src = malloc((size_t)CHUNK * PACK12_BYTES);
+	int16_t *iq = malloc((size_t)CHUNK * 4);
+	size_t n, total = 0;
+
+	if (!src || !iq) {
+		perror("malloc");
+		return 1;
+	}
+	while ((n = fread(src, PACK12_BYTES, CHUNK, in)) > 0) {
+		unpack12(iq, src, n);
+		if (fwrite(iq, 4, n, out) != n) {
+			perror("fwrite");
+			return 1;
+		}
+		total += n;
+	}
+	fclose(out);
+	fprintf(stderr, "%zu samples\n", total);
+	free(src);
+	free(iq);
+	return 0;
+}
+
+/* container summary */
+static int cmd_info(int argc, char **argv) {
+	struct iqz z;
+	size_t per_codec[256] = {0};
+
+	if (argc != 2) {
+		fputs("usage: iqtool info <in.iqz>\n", stderr);
+		return 1;
+	}
+	if (iqz_open(&z, argv[1]))
+		return 1;
+	for (size_t k = 0; k < z.tail.blocks; k++) {
+		struct iqz_block b;
+		if (fseeko(z.fl, z.index[k], SEEK_SET) || (fread(&b, sizeof(b), 1, z.fl) != 1)) {
+			fprintf(stderr, "block %zu: can't read\n", k);
+			return 1;
+		}
+		per_codec[b.codec]++;
+	}
+	printf("samples   %" PRIu64 " (%u bytes each)\n", z.tail.raw_size / z.hdr.ss, z.hdr.ss);
+	printf("raw size  %" PRIu64 "\n", z.tail.raw_size);
+	printf("file size %zu (ratio %.2f)\n", z.file_size, (double)z.tail.raw_size / z.file_size);
+	printf("blocks    %" PRIu64 " of %u bytes\n", z.tail.blocks, z.hdr.block);
+	for (int i = 0; i < 256; i++) {
+		const struct codec *c = codec_by_id(i);
+		if (per_codec[i])
+			printf("  %-6s  %zu\n", (i == CODEC_RAW) ? "stored" : c ? c->name : "?", per_codec[i]);
+	}
+	iqz_close(&z);
+	return 0;
+}
+
+/* samples from anywhere in a container, only the blocks needed are decoded */
+static int cmd_cat(int argc, char **argv) {
+	struct iqz z;
+	uint64_t first, count, pos, end;
+	uint8_t *buf;
+	long n;
+
+	if (argc < 3 || argc > 5) {
+		fputs("usage: iqtool cat <in.iqz> <out|-> [first sample [samples]]\n", stderr);
+		return 1;
+	}
+	if (iqz_open(&z, argv[1]))
+		return 1;
+	FILE *out = open_or_die(argv[2], "wb");
+	first = (argc > 3) ? strtoull(argv[3], NULL, 10) : 0;
+	count = (argc > 4) ? strtoull(argv[4], NULL, 10) : UINT64_MAX / z.hdr.ss;
+	pos = first * z.hdr.ss;
+	end = (count > (z.tail.raw_size - MIN(pos, z.tail.raw_size)) / z.hdr.ss) ? z.tail.raw_size : pos + count * z.hdr.ss;
+	if (!(buf = malloc(z.hdr.block))) {
+		perror("malloc");
+		return 1;
+	}
+	for (; pos < end; pos += n) {
+		if ((n = iqz_read(&z, buf, pos, MIN(end - pos, (uint64_t)z.hdr.block))) <= 0) {
+			fputs("read error\n", stderr);
+			return 1;
+		}
+		if (fwrite(buf, 1, n, out) != (size_t)n) {
+			perror("fwrite");
+			return 1;
+		}
+	}
+	fclose(out);
+	free(buf);
+	iqz_close(&z);
+	return 0;
+}
+
+/* samples left out by the squelch back in as zeros, from <in>.squelch */
+static int cmd_unsquelch(int argc, char **argv) {
+	char fn[4096], line[256];
+	uint64_t stream, file, dropped, pos = 0, zeros = 0;
+	size_t ss = 4, n;
+
+	if (argc < 3 || argc > 4) {
+		fputs("usage: iqtool unsquelch <in.iq> <out.iq|-> [sc8]\n", stderr);
+		return 1;
+	}
+	if (argc > 3)
+		ss = strcmp(argv[3], "sc8") ? 4 : 2;
+	snprintf(fn, sizeof(fn), "%s.squelch", argv[1]);
+	FILE *idx = open_or_die(fn, "r"), *in = open_or_die(argv[1], "rb"), *out = open_or_die(argv[2], "wb");
+	uint8_t *buf = calloc(CHUNK, ss);
+
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+	// a line per stretch: stream sample, file sample, samples left out
+	for (int eof = 0; !eof; ) {
+		if (!fgets(line, sizeof(line), idx)) {
+			eof = 1;
+			file = UINT64_MAX;
+			dropped = 0;
+		}
+		else if (*line == '#')
+			continue;
+		else if (sscanf(line, "%" SCNu64 " %" SCNu64 " %" SCNu64, &stream, &file, &dropped) != 3 ||
+				file < pos || stream != file + zeros) {
+			fprintf(stderr, "%s: bad line %s", fn, line);
+			return 1;
+		}
+		for (; pos < file; pos += n) {
+			if (!(n = fread(buf, ss, MIN(file - pos, (uint64_t)CHUNK), in)))
+				break;
+			if (fwrite(buf, ss, n, out) != n) {
+				perror("fwrite");
+				return 1;
+			}
+		}
+		if (!eof && pos < file) {
+			fprintf(stderr, "%s: ends at sample %" PRIu64 ", the index goes on to %" PRIu64 "\n", argv[1], pos, file);
+			return 1;
+		}
+		memset(buf, 0, (size_t)CHUNK * ss);
+		for (uint64_t k = 0; k < dropped; k += n) {
+			n = MIN(dropped - k, (uint64_t)CHUNK);
+			if (fwrite(buf, ss, n, out) != n) {
+				perror("fwrite");
+				return 1;
+			}
+		}
+		zeros += dropped;
+	}
+	fclose(out);
+	fclose(in);
+	fclose(idx);
+	fprintf(stderr, "%" PRIu64 " samples, %" PRIu64 " of them zeros\n", pos + zeros, zeros);
+	free(buf);
+	return 0;
+}
+
+/* offline rational resampling, SC16 or SC8 in, SC16 out */
+static int cmd_resample(int argc, char **argv) {
+	struct resamp r;
+	size_t ss = 4, n, total = 0, out_n = 0;
+	char *end;
+
+	if ((argc < 5) || (argc > 6) || ((argc == 6) && strcmp(argv[5], "sc8"))) {
+		fputs("usage: iqtool resample <in.iq|-> <out.iq|-> <in rate> <out rate>[:<pass>[:<dB>]] [sc8]\n", stderr);
+		return 1;
+	}
+	ss = (argc == 6) ? 2 : 4;
+	double rate = parse_freq(argv[3], &end);
+	if (*end || (rate <= 0) || resamp_parse(&r, argv[4], rate, ss))
+		return 1;
+	FILE *in = open_or_die(argv[1], "rb"), *out = open_or_die(argv[2], "wb");
+	uint8_t *buf = calloc(r.hist + CHUNK, ss);
+	int16_t *iq = malloc(((size_t)CHUNK * r.l / r.m + 1) * 4);
+	void *sc = resamp_scratch_new(&r, CHUNK);
+	if (!buf || !iq || !sc) {
+		perror("malloc");
+		return 1;
+	}
+	fprintf(stderr, "%.0f Hz to %.3f Hz: %d/%d, %d taps per phase\n", r.rate, r.out_rate, r.l, r.m, r.taps);
+
+	double t0 = now(), t = 0;
+	while ((n = fread(buf + r.hist * ss, ss, CHUNK, in)) > 0) {
+		double t1 = now();
+		size_t k = resamp_run(&r, sc, buf, n, total, iq);
+		t += now() - t1;
+		if (fwrite(iq, 4, k, out) != k) {
+			perror("fwrite");
+			return 1;
+		}
+		// the tail is the next chunk's history
+		memmove(buf, buf + n * ss, r.hist * ss);
+		total += n;
+		out_n += k;
+	}
+	fclose(out);
+	fprintf(stderr, "%zu samples in, %zu out, %.1f MS/s in on one core (%.1f with I/O)\n", total, out_n,
+		total / t / 1e6, total / (now() - t0) / 1e6);
+	resamp_scratch_free(sc);
+	resamp_free(&r);
+	free(buf);
+	free(iq);
+	return 0;
+}
+
+/* a whole capture through the spectrogram / index, closes sp */
+static int spectro_file(struct spectro *sp, const char *fn) {
+	FILE *in = open_or_die(fn, "rb");
+	size_t ss = sp->ss, n, total = 0;
+	uint8_t *buf = malloc((size_t)CHUNK * ss);
+	int bins = sp->n, frames = sp->frames;
+
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+	double t0 = now();
+	while ((n = fread(buf, ss, CHUNK, in)) > 0) {
+		if (spectro_run(sp, buf, n, total))
+			return 1;
+		total += n;
+	}
+	if (spectro_close(sp))
+		return 1;
+	fprintf(stderr, "%zu samples, %zu rows of %d frames, %.1f MS/s\n", total,
+		(total / bins + frames - 1) / frames, frames, total / (now() - t0) / 1e6);
+	free(buf);
+	return 0;
+}
+
+/* offline spectrogram sidecar, same as bladerf_rx -W */
+static int cmd_spectrogram(int argc, char **argv) {
+	struct spectro sp;
+	char *end;
+
+	if ((argc < 5) || (argc > 6) || ((argc == 6) && strcmp(argv[5], "sc8"))) {
+		fputs("usage: iqtool spectrogram <in.iq|-> <out.spec> <rate> <fft>[:<seconds>] [sc8]\n", stderr);
+		return 1;
+	}
+	double rate = parse_freq(argv[3], &end);
+	if (*end || (rate <= 0) || spectro_parse(&sp, argv[4], rate, (argc == 6) ? 2 : 4) ||
+			spectro_open(&sp, open_or_die(argv[2], "wb")))
+		return 1;
+	return spectro_file(&sp, argv[1]);
+}
+
+/* offline activity index, same as bladerf_rx -A (with -W <fft>[:<seconds>]) */
+static int cmd_index(int argc, char **argv) {
+	struct spectro sp;
+	int sc8 = !strcmp(argv[argc - 1], "sc8");
+	char *end;
+
+	if ((argc < 5) || (argc - sc8 > 6)) {
+		fputs("usage: iqtool index <in.iq|-> <out.act> <rate> <bands> [<fft>[:<seconds>]] [sc8]\n", stderr);
+		return 1;
+	}
+	double rate = parse_freq(argv[3], &end);
+	if (*end || (rate <= 0) || spectro_parse(&sp, (argc - sc8 > 5) ? argv[5] : "1024", rate, sc8 ? 2 : 4) ||
+			spectro_open_index(&sp, open_or_die(argv[2], "wb"), atoi(argv[4]), 1))
+		return 1;
+	return spectro_file(&sp, argv[1]);
+}
+
+/* sidecar with a header starting with magic into memory, rows after it; returns the number of complete rows */
+static size_t sidecar_load(const char *fn, const char *magic, void *hdr, size_t hdr_len, uint8_t **rows,
+	size_t (*row_len)(const void *hdr))
+{
+	FILE *fl = open_or_die(fn, "rb");
+	size_t n, len;
+
+	if ((fread(hdr, hdr_len, 1, fl) != 1) || memcmp(hdr, magic, 4)) {
+		fprintf(stderr, "%s: not a %s sidecar\n", fn, magic);
+		exit(1);
+	}
+	len = row_len(hdr);
+	if (fseeko(fl, 0, SEEK_END) || ((n = (ftello(fl) - hdr_len) / len), fseeko(fl, hdr_len, SEEK_SET)) ||
+			!(*rows = malloc(n * len + 1)) || (fread(*rows, len, n, fl) != n)) {
+		perror(fn);
+		exit(1);
+	}
+	fclose(fl);
+	return n;
+}
+
+static size_t spec_row_len(const void *hdr) {
+	return sizeof(struct spec_row) + 2 * (size_t)((const struct spec_header *)hdr)->fft;
+}
+
+static size_t act_row_len(const void *hdr) {
+	return sizeof(struct act_row) + sizeof(struct act_band) * ((const struct act_header *)hdr)->bands;
+}
+
+/* spectrogram to a PGM image, time going down; bins and rows are merged by their maximum */
+static int cmd_waterfall(int argc, char **argv) {
+	struct spec_header h;
+	uint8_t *rows, lo = 255, hi = 0;
+	int peak = (argc > 3) && !strcmp(argv[3], "peak");
+
+	if ((argc < 3) || (argc > 6) || ((argc > 3) && !peak && strcmp(argv[3], "mean"))) {
+		fputs("usage: iqtool waterfall <in.spec> <out.pgm> [mean|peak [<width> [<height>]]]\n", stderr);
+		return 1;
+	}
+	double t0 = now();
+	size_t n = sidecar_load(argv[1], SPEC_MAGIC, &h, sizeof(h), &rows, spec_row_len), len = spec_row_len(&h);
+	size_t w = (argc > 4) ? strtoul(argv[4], NULL, 10) : MIN(h.fft, 1024);
+	size_t ht = (argc > 5) ? strtoul(argv[5], NULL, 10) : MIN(n, 2048);
+	if (!n || !w || !ht) {
+		fputs("nothing to draw\n", stderr);
+		return 1;
+	}
+	w = MIN(w, h.fft);
+	ht = MIN(ht, n);
+	uint8_t *img = calloc(w, ht);
+	if (!img) {
+		perror("malloc");
+		return 1;
+	}
+	for (size_t r = 0; r < n; r++) {
+		const uint8_t *bins = rows + r * len + sizeof(struct spec_row) + (peak ? h.fft : 0);
+		uint8_t *px = img + r * ht / n * w;
+		for (size_t i = 0; i < h.fft; i++) {
+			size_t x = i * w / h.fft;
+			px[x] = MAX(px[x], bins[i]);
+		}
+	}
+	// stretch the levels present to the full grey scale
+	for (size_t i = 0; i < w * ht; i++) {
+		lo = MIN(lo, img[i]);
+		hi = MAX(hi, img[i]);
+	}
+	for (size_t i = 0; (hi > lo) && (i < w * ht); i++)
+		img[i] = (img[i] - lo) * 255 / (hi - lo);
+	FILE *out = open_or_die(argv[2], "wb");
+	fprintf(out, "P5\n%zu %zu\n255\n", w, ht);
+	if (fwrite(img, w, ht, out) != ht) {
+		perror("fwrite");
+		return 1;
+	}
+	fclose(out);
+	const struct spec_row *last = (const struct spec_row *)(rows + (n - 1) * len);
+	fprintf(stderr, "%zu rows over %.1f s, %zu x %zu, %.1f to %.1f dBFS (%s), %.1f ms\n", n,
+		(last->start + (uint64_t)last->frames * h.fft) / h.rate, w, ht, (lo - 255) / 2.0, (hi - 255) / 2.0,
+		peak ? "peak" : "mean", (now() - t0) * 1e3);
+	free(rows);
+	free(img);
+	return 0;
+}
+
+/* offline magnitude pyramid, same as bladerf_rx -M */
+static int cmd_pyramid(int argc, char **argv) {
+	struct pyramid p;
+	struct stat st;
+	int sc8 = !strcmp(argv[argc - 1], "sc8");
+	size_t ss = sc8 ? 2 : 4, n, total = 0;
+	char *end;
+
+	if ((argc < 4) || (argc - sc8 > 5)) {
+		fputs("usage: iqtool pyramid <in.iq> <out.pyr> <rate> [<samples per entry>] [sc8]\n", stderr);
+		return 1;
+	}
+	double rate = parse_freq(argv[3], &end);
+	FILE *in = open_or_die(argv[1], "rb");
+	if (*end || (rate <= 0) || fstat(fileno(in), &st) ||
+			pyramid_open(&p, open_or_die(argv[2], "wb"), rate, ss, (argc - sc8 > 4) ? atoi(argv[4]) : 4096, st.st_size / ss))
+		return 1;
+	uint8_t *buf = malloc((size_t)CHUNK * ss);
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+	double t0 = now(), t = 0;
+	while ((n = fread(buf, ss, CHUNK, in)) > 0) {
+		double t1 = now();
+		if (pyramid_run(&p, buf, n, total))
+			return 1;
+		t += now() - t1;
+		total += n;
+	}
+	uint32_t levels = p.hdr.levels;
+	if (pyramid_close(&p))
+		return 1;
+	fprintf(stderr, "%zu samples, %u levels, %.1f MS/s on one core (%.1f with I/O)\n", total, levels,
+		total / t / 1e6, total / (now() - t0) / 1e6);
+	free(buf);
+	return 0;
+}
+
+/* a zoom level of the capture from the pyramid alone: min, max, RMS per point */
+static int cmd_overview(int argc, char **argv) {
+	struct pyr_header h;
+
+	if ((argc != 3) && (argc != 5)) {
+		fputs("usage: iqtool overview <in.pyr> [<from s> <to s>] <points>\n", stderr);
+		return 1;
+	}
+	double t0 = now();
+	FILE *fl = open_or_die(argv[1], "rb");
+	if ((fread(&h, sizeof(h), 1, fl) != 1) || memcmp(h.magic, PYR_MAGIC, 4)) {
+		fprintf(stderr, "%s: not a pyramid\n", argv[1]);
+		return 1;
+	}
+	uint64_t from = (argc == 5) ? atof(argv[2]) * h.rate : 0, to = (argc == 5) ? atof(argv[3]) * h.rate : h.samples;
+	uint64_t points = strtoull(argv[argc - 1], NULL, 10);
+	to = MIN(to, h.samples);
+	if ((from >= to) || !points) {
+		fputs("empty range\n", stderr);
+		return 1;
+	}
+	// the coarsest level that still has an entry per point
+	int l = pyramid_level(&h, to - from, points);
+	uint64_t span = (uint64_t)h.base << l, first = from / span, last = (to - 1) / span, n = last - first + 1;
+	struct pyr_entry *e = malloc(n * sizeof(*e));
+	if (!e || fseeko(fl, h.offset[l] + first * sizeof(*e), SEEK_SET) || (fread(e, sizeof(*e), n, fl) != n)) {
+		perror(argv[1]);
+		return 1;
+	}
+	fclose(fl);
+	printf("# level %d, %" PRIu64 " samples per entry, %" PRIu64 " entries, |x| in LSB\n", l, span, n);
+	printf("# time_s min max rms\n");
+	points = MIN(points, n);
+	for (uint64_t i = 0; i < points; i++) {
+		uint64_t a = i * n / points, b = (i + 1) * n / points;
+		double lo = INFINITY, hi = 0, pw = 0;
+		for (uint64_t k = a; k < b; k++) {
+			lo = fmin(lo, e[k].min);
+			hi = fmax(hi, e[k].max);
+			pw += (double)e[k].rms * e[k].rms;
+		}
+		printf("%.6f %.2f %.2f %.2f\n", (first + a) * span / h.rate, lo / PYR_SCALE, hi / PYR_SCALE,
+			sqrt(pw / (b - a)) / PYR_SCALE);
+	}
+	fprintf(stderr, "%zu bytes read in %.2f ms\n", sizeof(h) + n * sizeof(*e), (now() - t0) * 1e3);
+	free(e);
+	return 0;
+}
+
+/* copies bytes [ofs, ofs + len) of the capture, mapping only those pages */
+static int copy_range(int fd, size_t size, uint64_t ofs, uint64_t len, FILE *out) {
+	static long page;
+	page = page ? page : sysconf(_SC_PAGESIZE);
+	if (ofs >= size)
+		return 0;
+	len = MIN(len, size - ofs);
+	uint64_t base = ofs / page * page;
+	uint8_t *p = mmap(NULL, len + ofs - base, PROT_READ, MAP_SHARED, fd, base);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	madvise(p, len + ofs - base, MADV_SEQUENTIAL);
+	int res = (fwrite(p + ofs - base, 1, len, out) != len) ? -1 : 0;
+	munmap(p, len + ofs - base);
+	if (res)
+		perror("fwrite");
+	return res;
+}
+
+/*
+ * Time ranges with activity in a sub-band, from the index next to the
+ * capture. Matching rows are merged, with out given the ranges are also
+ * copied out of the capture. Only plain sc16 / sc8 captures have byte
+ * offsets, for all others the index says so and ranges are stream samples.
+ */
+static int cmd_query(int argc, char **argv) {
+	static const char *metrics[] = { "level", "peak", "occ" };
+	struct act_header h;
+	uint8_t *rows;
+	char fn[4096], *end;
+	int metric = 0;
+
+	while ((argc > 4) && (metric < 3) && strcmp(argv[4], metrics[metric]))
+		metric++;
+	if ((argc < 4) || (argc > 6) || (metric == 3)) {
+		fputs("usage: iqtool query <capture> <lo>:<hi> <threshold> [level|peak|occ [<out.iq>]]\n", stderr);
+		fputs("       lo, hi: Hz off the center (k/M), threshold: dBFS for level and peak, % for occ\n", stderr);
+		return 1;
+	}
+	double lo = parse_freq(argv[2], &end), hi = (*end == ':') ? parse_freq(end + 1, &end) : lo;
+	double thr = atof(argv[3]);
+	if (*end || (hi < lo)) {
+		fprintf(stderr, "bad sub-band %s\n", argv[2]);
+		return 1;
+	}
+	double t0 = now();
+	snprintf(fn, sizeof(fn), "%s.act", argv[1]);
+	size_t n = sidecar_load(fn, ACT_MAGIC, &h, sizeof(h), &rows, act_row_len), len = act_row_len(&h);
+	int first = floor((lo + h.rate / 2) * h.bands / h.rate), last = ceil((hi + h.rate / 2) * h.bands / h.rate) - 1;
+	first = MAX(first, 0);
+	last = MIN(MAX(last, first), (int)h.bands - 1);
+	int code = (metric == 2) ? lrint(thr * 255 / 100) : lrint(255 + 2 * thr);
+	code = MAX(code, 0);
+
+	FILE *out = NULL;
+	int fd = -1;
+	struct stat st;
+	if ((argc == 6) && !h.linear) {
+		fprintf(stderr, "%s: not a plain sc16 / sc8 capture (packed, compressed, ring, segmented, striped, squelched or filtered), can't extract\n", argv[1]);
+		free(rows);
+		return 1;
+	}
+	if (argc == 6) {
+		if (((fd = open(argv[1], O_RDONLY)) < 0) || fstat(fd, &st)) {
+			perror(argv[1]);
+			return 1;
+		}
+		out = open_or_die(argv[5], "wb");
+	}
+
+	printf("# bands %d..%d (%.0f to %.0f Hz), %s >= %g%s\n", first, last, -h.rate / 2 + first * h.rate / h.bands,
+		-h.rate / 2 + (last + 1) * h.rate / h.bands, metrics[metric], thr, (metric == 2) ? "%" : " dBFS");
+	printf("# start_sample end_sample start_s duration_s byte_offset byte_length\n");
+	uint64_t r_start = 0, r_end = 0, hits = 0, total = 0;
+	int open_range = 0;
+	for (size_t i = 0; i <= n; i++) {
+		const struct act_row *r = (const struct act_row *)(rows + i * len);
+		int match = 0;
+		if (i < n) {
+			const struct act_band *b = (const struct act_band *)(r + 1);
+			for (int k = first; (k <= last) && !match; k++)
+				match = ((metric == 0) ? b[k].level : (metric == 1) ? b[k].peak : b[k].occ) >= code;
+		}
+		if (open_range && (!match || (r->start > r_end))) {
+			printf("%" PRIu64 " %" PRIu64 " %.3f %.3f ", r_start, r_end, r_start / h.rate, (r_end - r_start) / h.rate);
+			if (h.linear)
+				printf("%" PRIu64 " %" PRIu64 "\n", r_start * h.ss, (r_end - r_start) * h.ss);
+			else
+				puts("- -");
+			if (out && copy_range(fd, st.st_size, r_start * h.ss, (r_end - r_start) * h.ss, out))
+				return 1;
+			hits++;
+			total += r_end - r_start;
+			open_range = 0;
+		}
+		if (match) {
+			if (!open_range)
+				r_start = r->start;
+			r_end = r->start + (uint64_t)r->frames * h.fft;
+			open_range = 1;
+		}
+	}
+	const struct act_row *r = (const struct act_row *)(rows + (n ? n - 1 : 0) * len);
+	fprintf(stderr, "%" PRIu64 " ranges, %.3f of %.3f s, %zu index rows in %.1f ms\n", hits, total / h.rate,
+		n ? (r->start + (uint64_t)r->frames * h.fft) / h.rate : 0.0, n, (now() - t0) * 1e3);
+	if (out)
+		fclose(out);
+	if (fd >= 0)
+		close(fd);
+	free(rows);
+	return 0;
+}
+
+/* block codecs on a recorded capture: ratio, one core throughput, round trip */
+static int cmd_bench_codec(int argc, char **argv) {
+	static const char *all[] = { "zstd", "lz4", "lpc", "quant" };
+	const char **specs = (argc > 2) ? (const char **)argv + 2 : all;
+	int nspecs = (argc > 2) ? argc - 2 : (int)(sizeof(all) / sizeof(all[0])), fail = 0;
+	size_t len, nblk;
+	uint8_t *raw, *back, *out;
+	FILE *fl;
+
+	if (argc < 2) {
+		fputs("usage: iqtool bench-codec <capture.iq> [codec[:level] ...]\n", stderr);
+		return 1;
+	}
+	fl = open_or_die(argv[1], "rb");
+	fseeko(fl, 0, SEEK_END);
+	// whole SC16 samples, at most 1 GB
+	len = MIN((size_t)ftello(fl), (size_t)1000000000) & ~(size_t)3;
+	rewind(fl);
+	nblk = (len + IQZ_BLOCK - 1) / IQZ_BLOCK;
+	raw = malloc(len);
+	back = malloc(len);
+	out = malloc(2 * (size_t)IQZ_BLOCK);
+	if (!raw || !back || !out) {
+		perror("malloc");
+		return 1;
+	}
+	if (fread(raw, 1, len, fl) != len) {
+		perror("fread");
+		return 1;
+	}
+	fclose(fl);
+	printf("%s: %zu samples in %zu blocks, need %.2f MS/s\n", argv[1], len / 4, nblk, MAX_SAMPLERATE / 1e6);
+
+	for (int i = 0; i < nspecs; i++) {
+		int level;
+		const struct codec *c = codec_parse(specs[i], &level);
+		void *ctx;
+		size_t stored = 0, cap;
+		double t_enc = 0, t_dec = 0;
+		int ok = 1;
+
+		if (!c || !(ctx = c->ctx_new(level))) {
+			fprintf(stderr, "%s: unknown codec or out of memory\n", specs[i]);
+			return 1;
+		}
+		cap = MIN(c->bound(IQZ_BLOCK), 2 * (size_t)IQZ_BLOCK);
+		for (size_t k = 0; k < nblk; k++) {
+			size_t ofs = k * IQZ_BLOCK, n = MIN((size_t)IQZ_BLOCK, len - ofs), clen;
+			double t0 = now();
+			clen = c->compress(ctx, out, cap, raw + ofs, n);
+			double t1 = now();
+			if (!clen || (clen >= n)) {
+				// the container would store this one as is
+				memcpy(back + ofs, raw + ofs, n);
+				stored += n;
+				t_enc += t1 - t0;
+				continue;
+			}
+			ok &= !c->decompress(back + ofs, n, out, clen);
+			t_dec += now() - t1;
+			t_enc += t1 - t0;
+			stored += clen;
+		}
+		printf("%-8s ratio %5.3f  encode %7.1f MS/s (%4.1fx)  decode %7.1f MS/s  ", specs[i],
+			(double)len / stored, len / 4 / t_enc / 1e6, len / 4 / t_enc / MAX_SAMPLERATE,
+			t_dec ? len / 4 / t_dec / 1e6 : 0);
+		if (c->lossy) {
+			const int16_t *a = (const int16_t *)raw, *b = (const int16_t *)back;
+			double err = 0, sig = 0;
+			int max = 0;
+			for (size_t j = 0; j < len / 2; j++) {
+				int d = abs(a[j] - b[j]);
+				err += (double)d * d;
+				sig += (double)a[j] * a[j];
+				max = (d > max) ? d : max;
+			}
+			printf("%s, error %.2f LSB rms (max %d, SNR %.1f dB)\n", ok ? "decoded" : "DECODE FAILED",
+				sqrt(err / (len / 2)), max, err ? 10 * log10(sig / err) : INFINITY);
+		}
+		else {
+			ok &= !memcmp(raw, back, len);
+			puts(ok ? "round trip ok" : "ROUND TRIP FAILED");
+		}
+		fail |= !ok;
+		c->ctx_free(ctx);
+	}
+	free(raw);
+	free(back);
+	free(out);
+	return fail;
+}
+
+/* pack and unpack throughput of every kernel the CPU has, on one core */
+static int cmd_bench_pack(int argc, char **argv) {
+	size_t n = (argc > 1) ? strtoull(argv[1], NULL, 10) * 1000000 : 32000000, nimpl;
+	const struct pack12_impl *impl = pack12_impls(&nimpl);
+	int16_t *iq = malloc(n * 4), *back = malloc(n * 4);
+	uint8_t *packed = malloc(n * PACK12_BYTES);
+	uint32_t rng = 1;
+	int fail = 0;
+
+	if (!iq || !back || !packed) {
+		perror("malloc");
+		return 1;
+	}
+	for (size_t i = 0; i < n * 2; i++) {
+		rng = rng * 1664525u + 1013904223u;
+		iq[i] = (int16_t)(rng >> 20) - 2048;    // full 12 bit range
+	}
+	printf("%zu M samples, need %.2f MS/s\n", n / 1000000, MAX_SAMPLERATE / 1e6);
+	for (size_t k = 0; k < nimpl; k++) {
+		if (!impl[k].usable()) {
+			printf("%-6s not supported by this CPU\n", impl[k].name);
+			continue;
+		}
+		memset(packed, 0, n * PACK12_BYTES);
+		memset(back, 0, n * 4);
+		// once to fault everything in, then timed
+		impl[k].pack(packed, iq, n);
+		double t0 = now();
+		impl[k].pack(packed, iq, n);
+		double t1 = now();
+		impl[k].unpack(back, packed, n);
+		double t2 = now();
+		impl[k].unpack(back, packed, n);
+		double t3 = now();
+		int ok = !memcmp(iq, back, n * 4);
+		fail |= !ok;
+		printf("%-6s pack %8.1f MS/s (%5.1fx)  unpack %8.1f MS/s (%5.1fx)  %s\n", impl[k].name,
+			n / (t1 - t0) / 1e6, n / (t1 - t0) / MAX_SAMPLERATE,
+			n / (t3 - t2) / 1e6, n / (t3 - t2) / MAX_SAMPLERATE, ok ? "round trip ok" : "ROUND TRIP FAILED");
+	}
+	printf("selected: %s\n", pack12_name());
+	free(iq);
+	free(back);
+	free(packed);
+	return fail;
+}
+
+/* level of a tone at f Hz in n SC16 samples at rate, relative to amplitude a */
+static double tone_db(const int16_t *iq, size_t n, double f, double rate, double a) {
+	double re = 0, im = 0;
+	for (size_t m = 0; m < n; m++) {
+		double ph = -2 * M_PI * fmod(f * m / rate, 1);
+		re += iq[2 * m] * cos(ph) - iq[2 * m + 1] * sin(ph);
+		im += iq[2 * m] * sin(ph) + iq[2 * m + 1] * cos(ph);
+	}
+	return 20 * log10(hypot(re, im) / n / a + 1e-20);
+}
+
+static int cmd_bench_ddc(int argc, char **argv) {
+	const char *spec = (argc > 1) ? argv[1] : "1M:240k";
+	double rate = (argc > 2) ? atof(argv[2]) * 1e6 : MAX_SAMPLERATE;
+	size_t n = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1000000 : 16000000, block = 1 << 18, out_n = 0;
+	struct ddc d;
+	int16_t *buf, *out;
+	void *sc;
+
+	if (ddc_parse(&d, spec, rate, 4))
+		return 1;
+	// blocks have to start on an output sample
+	block = (block + d.decim - 1) / d.decim * d.decim;
+	n = (n + block - 1) / block * block;
+	buf = calloc(d.hist + n, 4);
+	out = malloc((n / d.decim + 1) * 4);
+	if (!buf || !out || !(sc = ddc_scratch_new(&d, block))) {
+		perror("malloc");
+		return 1;
+	}
+
+	// a tone in the channel, one that would alias into it and some noise
+	double f_in = d.offset + 0.2 * d.out_rate, f_out = d.offset + 0.75 * d.out_rate, amp = 500;
+	int16_t *iq = buf + 2 * d.hist;
+	uint32_t rng = 1;
+	for (size_t i = 0; i < n; i++) {
+		double a1 = 2 * M_PI * fmod(f_in * i / rate, 1), a2 = 2 * M_PI * fmod(f_out * i / rate, 1);
+		rng = rng * 1664525u + 1013904223u;
+		iq[2 * i] = lrint(amp * (cos(a1) + cos(a2))) + (int)(rng >> 28) - 8;
+		iq[2 * i + 1] = lrint(amp * (sin(a1) + sin(a2))) + (int)((rng >> 24) & 15) - 8;
+	}
+
+	printf("%.2f MS/s to %.2f kS/s at %+.0f Hz, decimation/taps per stage:", rate / 1e6, d.out_rate / 1e3, d.offset);
+	for (int i = 0; i < d.nstages; i++)
+		printf(" %d/%d", d.st[i].d, d.st[i].taps);
+	printf("\n");
+
+	// blocks the way the sink runs them, history in front
+	double t0 = now();
+	for (size_t ofs = 0; ofs < n; ofs += block)
+		out_n += ddc_run(&d, sc, buf + 2 * ofs, block, ofs, out + 2 * out_n);
+	double t = now() - t0;
+
+	size_t skip = d.hist / d.decim + 1;     // start-up transient
+	double full = amp / 2048 * 32767;
+	printf("%zu M samples: %.1f MS/s on one thread, %.2fx real time, %d thread(s) needed\n", n / 1000000,
+		n / t / 1e6, n / t / rate, (int)ceil(rate * t / n));
+	printf("tone in the channel %+.2f dB, alias suppressed by %.1f dB\n",
+		tone_db(out + 2 * skip, out_n - skip, f_in - d.offset, d.out_rate, full),
+		-tone_db(out + 2 * skip, out_n - skip, f_out - d.offset, d.out_rate, full));
+	ddc_scratch_free(sc);
+	ddc_free(&d);
+	free(buf);
+	free(out);
+	return 0;
+}
+
+static int cmd_bench_pfb(int argc, char **argv) {
+	const char *spec = (argc > 1) ? argv[1] : "64";
+	double rate = (argc > 2) ? atof(argv[2]) * 1e6 : MAX_SAMPLERATE;
+	size_t n = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1000000 : 16000000, block = 1 << 18, out_n = 0;
+	int oversample = (argc > 4) && !strcmp(argv[4], "os");
+	struct pfb p;
+	int16_t *buf, *out;
+	void *sc;
+
+	if (pfb_parse(&p, spec, oversample, rate, 4))
+		return 1;
+	block = (block + p.decim - 1) / p.decim * p.decim;
+	n = (n + block - 1) / block * block;
+	size_t stride = block / p.decim, total = n / p.decim;
+	buf = calloc(p.hist + n, 4);
+	out = malloc(p.nsel * total * 4);
+	int16_t *tmp = malloc(p.nsel * stride * 4);
+	if (!buf || !out || !tmp || !(sc = pfb_scratch_new(&p, block))) {
+		perror("malloc");
+		return 1;
+	}
+
+	// a tone a bit off the center of the first selected channel
+	double spacing = rate / p.nch, f = (p.sel[0] + 0.1) * spacing, amp = 1000;
+	int16_t *iq = buf + 2 * p.hist;
+	for (size_t i = 0; i < n; i++) {
+		double a = 2 * M_PI * fmod(f * i / rate, 1);
+		iq[2 * i] = lrint(amp * cos(a));
+		iq[2 * i + 1] = lrint(amp * sin(a));
+	}
+	printf("%.2f MS/s into %d channels of %.1f kHz at %.1f kS/s, %d taps, %d selected\n", rate / 1e6,
+		p.nch, spacing / 1e3, rate / p.decim / 1e3, p.taps, p.nsel);
+
+	double t0 = now();
+	for (size_t ofs = 0; ofs < n; ofs += block) {
+		size_t k = pfb_run(&p, sc, buf + 2 * ofs, block, ofs, tmp, stride);
+		for (int i = 0; i < p.nsel; i++)
+			memcpy(out + 2 * (i * total + out_n), tmp + 2 * i * stride, k * 4);
+		out_n += k;
+	}
+	double t = now() - t0;
+
+	// level in its own channel, worst leak into a channel not next to it
+	size_t skip = p.hist / p.decim + 1;
+	double full = amp / 2048 * 32767, leak = -200;
+	double own = tone_db(out + 2 * skip, out_n - skip, 0.1 * spacing, rate / p.decim, full);
+	for (int i = 1; i < p.nsel; i++) {
+		int d = abs(p.sel[i] - p.sel[0]);
+		if ((d > 1) && (d < p.nch - 1)) {
+			double sum = 0;
+			for (size_t m = skip; m < out_n; m++) {
+				const int16_t *y = out + 2 * (i * total + m);
+				sum += (double)y[0] * y[0] + (double)y[1] * y[1];
+			}
+			leak = fmax(leak, 10 * log10(sum / (out_n - skip) / (full * full) + 1e-20));
+		}
+	}
+	printf("%zu M samples: %.1f MS/s on one thread, %.2fx real time, %d thread(s) needed\n", n / 1000000,
+		n / t / 1e6, n / t / rate, (int)ceil(rate * t / n));
+	printf("tone in channel %d %+.2f dB, worst other channel %.1f dB\n", p.sel[0], own, leak);
+	pfb_scratch_free(sc);
+	pfb_free(&p);
+	free(buf);
+	free(out);
+	free(tmp);
+	return 0;
+}
+
+/* seconds for n samples through o, outputs to out if not NULL */
+static double run_ols(const struct ols *o, const int16_t *buf, size_t n, size_t block, int16_t *out, size_t total) {
+	size_t ofs[OLS_MAX_CH], cnt = 0;
+	int16_t *tmp;
+	void *sc;
+
+	for (int i = 0; i < o->nch; i++)
+		cnt += (ofs[i] = block / o->ch[i].decim);
+	if (!(tmp = malloc(cnt * 4)) || !(sc = ols_scratch_new(o, block))) {
+		perror("malloc");
+		exit(1);
+	}
+	for (size_t i = 0, sum = 0; i < (size_t)o->nch; i++) {
+		size_t k = ofs[i];
+		ofs[i] = sum;
+		sum += k;
+	}
+
+	double t0 = now();
+	for (size_t pos = 0; pos < n; pos += block) {
+		ols_run(o, sc, buf + 2 * pos, block, pos, tmp, ofs);
+		for (int i = 0; out && (i < o->nch); i++) {
+			size_t k = block / o->ch[i].decim;
+			memcpy(out + 2 * (i * total + pos / o->ch[i].decim), tmp + 2 * ofs[i], k * 4);
+		}
+	}
+	double t = now() - t0;
+	ols_scratch_free(sc);
+	free(tmp);
+	return t;
+}
+
+static int cmd_bench_ols(int argc, char **argv) {
+	const char *spec = (argc > 1) ? argv[1] : "1M:200k,-2.5M:50k,7.3M:1.2M,-20M:5M";
+	double rate = (argc > 2) ? atof(argv[2]) * 1e6 : MAX_SAMPLERATE;
+	size_t n = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1000000 : 16000000, block = 1 << 18;
+	struct ols o;
+	int16_t *buf, *out;
+
+	if (ols_parse(&o, spec, rate, 4))
+		return 1;
+	block = (block + o.step - 1) / o.step * o.step;
+	n = (n + block - 1) / block * block;
+	size_t total = 0;
+	for (int i = 0; i < o.nch; i++)
+		total = MAX(total, n / o.ch[i].decim);
+	buf = calloc(o.hist + n, 4);
+	out = calloc(o.nch * total, 4);
+	if (!buf || !out) {
+		perror("malloc");
+		return 1;
+	}
+
+	// a tone inside the first channel
+	const struct ols_chan *c0 = &o.ch[0];
+	double f = c0->offset + c0->bw / 4, amp = 1000;
+	int16_t *iq = buf + 2 * o.hist;
+	for (size_t i = 0; i < n; i++) {
+		double a = 2 * M_PI * fmod(f * i / rate, 1);
+		iq[2 * i] = lrint(amp * cos(a));
+		iq[2 * i + 1] = lrint(amp * sin(a));
+	}
+	printf("%.2f MS/s, %d point FFT every %d samples, %d channels:\n", rate / 1e6, o.n, o.step, o.nch);
+	for (int i = 0; i < o.nch; i++) {
+		const struct ols_chan *c = &o.ch[i];
+		printf("  %d: %.0f Hz, %.1f kHz wide at %.1f kS/s, %d taps\n", i, c->offset, c->bw / 1e3,
+			c->out_rate / 1e3, c->taps);
+	}
+
+	// all of them, then the first one alone on the same FFT
+	double t = run_ols(&o, buf, n, block, out, total);
+	struct ols first = o;
+	first.nch = 1;
+	double t1 = run_ols(&first, buf, n, block, NULL, 0);
+
+	// level in the first channel, worst leak into another one
+	double full = amp / 2048 * 32767, leak = -200;
+	for (int i = 1; i < o.nch; i++) {
+		size_t cnt = n / o.ch[i].decim, skip = o.hist / o.ch[i].decim + 1;
+		double sum = 0;
+		for (size_t m = skip; m < cnt; m++) {
+			const int16_t *y = out + 2 * (i * total + m);
+			sum += (double)y[0] * y[0] + (double)y[1] * y[1];
+		}
+		leak = fmax(leak, 10 * log10(sum / (cnt - skip) / (full * full) + 1e-20));
+	}
+	size_t skip = o.hist / c0->decim + 1;
+	printf("%zu M samples: %.1f MS/s on one thread, %.2fx real time, %d thread(s) needed\n", n / 1000000,
+		n / t / 1e6, n / t / rate, (int)ceil(rate * t / n));
+	printf("channel 0 alone: %.1f MS/s, the other %d cost %.0f%% more\n", n / t1 / 1e6, o.nch - 1, (t / t1 - 1) * 100);
+	printf("tone in channel 0 %+.2f dB, worst other channel %.1f dB\n",
+		tone_db(out + 2 * skip, n / c0->decim - skip, c0->bw / 4, c0->out_rate, full), leak);
+	ols_free(&o);
+	free(buf);
+	free(out);
+	return 0;
+}
+
+static int cmd_bench_resamp(int argc, char **argv) {
+	const char *spec = (argc > 1) ? argv[1] : "2.4M";
+	double rate = (argc > 2) ? atof(argv[2]) * 1e6 : MAX_SAMPLERATE;
+	size_t n = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1000000 : 16000000, block = 1 << 18, out_n = 0;
+	struct resamp r;
+	int16_t *buf, *out;
+	void *sc;
+
+	if (resamp_parse(&r, spec, rate, 4))
+		return 1;
+	n = (n + block - 1) / block * block;
+	buf = calloc(r.hist + n, 4);
+	out = malloc(resamp_count(&r, n, 0) * 4);
+	if (!buf || !out || !(sc = resamp_scratch_new(&r, block))) {
+		perror("malloc");
+		return 1;
+	}
+
+	// a tone in the passband (off any short period, its rounding error would land on the image);
+	// decimating, one that would alias, else the first image of the tone
+	double lo = fmin(rate, r.out_rate), f_in = 0.2137 * lo, f_bad = 0.75 * r.out_rate, amp = 500;
+	double f_meas = (r.out_rate < rate) ? f_bad - r.out_rate : f_in - rate;
+	int aliasing = (r.out_rate < rate) && (f_bad < rate / 2);
+	int16_t *iq = buf + 2 * r.hist;
+	for (size_t i = 0; i < n; i++) {
+		double a1 = 2 * M_PI * fmod(f_in * i / rate, 1), a2 = 2 * M_PI * fmod(f_bad * i / rate, 1);
+		iq[2 * i] = lrint(amp * (cos(a1) + aliasing * cos(a2)));
+		iq[2 * i + 1] = lrint(amp * (sin(a1) + aliasing * sin(a2)));
+	}
+	printf("%.3f MS/s to %.3f kS/s: %d/%d, %d taps per phase\n", rate / 1e6, r.out_rate / 1e3, r.l, r.m, r.taps);
+
+	double t0 = now();
+	for (size_t ofs = 0; ofs < n; ofs += block)
+		out_n += resamp_run(&r, sc, buf + 2 * ofs, block, ofs, out + 2 * out_n);
+	double t = now() - t0;
+
+	size_t skip = resamp_count(&r, r.hist, 0) + 1;
+	double full = amp / 2048 * 32767;
+	printf("%zu M samples: %.1f MS/s in, %.1f MS/s out on one core, %.2fx real time, %d core(s) needed\n",
+		n / 1000000, n / t / 1e6, out_n / t / 1e6, n / t / rate, (int)ceil(rate * t / n));
+	printf("tone in the passband %+.2f dB, %s suppressed by %.1f dB\n",
+		tone_db(out + 2 * skip, out_n - skip, f_in, r.out_rate, full), aliasing ? "alias" : "image",
+		-tone_db(out + 2 * skip, out_n - skip, f_meas, r.out_rate, full));
+	resamp_scratch_free(sc);
+	resamp_free(&r);
+	free(buf);
+	free(out);
+	return 0;
+}
+
+static int cmd_bench_pyr(int argc, char **argv) {
+	int base = (argc > 1) ? atoi(argv[1]) : 4096;
+	int sc8 = (argc > 2) && !strcmp(argv[2], "sc8");
+	size_t n = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1000000 : 256000000, block = 1 << 18, ss = sc8 ? 2 : 4;
+	struct pyramid p;
+	struct pyr_header h;
+	uint8_t *buf;
+
+	n = (n + block - 1) / block * block;
+	FILE *fl = tmpfile();
+	if (!fl || !(buf = malloc(block * ss))) {
+		perror("tmpfile");
+		return 1;
+	}
+	if (pyramid_open(&p, fdopen(dup(fileno(fl)), "wb"), MAX_SAMPLERATE, ss, base, n))
+		return 1;
+	// a ramp of amplitudes, the last block's peak is the stream's maximum
+	for (size_t i = 0; i < block; i++) {
+		double a = 2 * M_PI * i / 37.0, amp = (sc8 ? 100 : 1600) * (i + 1.0) / block;
+		if (sc8) {
+			buf[2 * i] = (int8_t)lrint(amp * cos(a));
+			buf[2 * i + 1] = (int8_t)lrint(amp * sin(a));
+		}
+		else {
+			((int16_t *)buf)[2 * i] = lrint(amp * cos(a));
+			((int16_t *)buf)[2 * i + 1] = lrint(amp * sin(a));
+		}
+	}
+	double t0 = now();
+	for (size_t ofs = 0; ofs < n; ofs += block)
+		pyramid_run(&p, buf, block, ofs);
+	double t = now() - t0;
+	uint32_t levels = p.hdr.levels;
+	if (pyramid_close(&p))
+		return 1;
+
+	// the top entry covers everything
+	struct pyr_entry top;
+	if (fseeko(fl, 0, SEEK_SET) || (fread(&h, sizeof(h), 1, fl) != 1) ||
+			fseeko(fl, h.offset[levels - 1], SEEK_SET) || (fread(&top, sizeof(top), 1, fl) != 1)) {
+		perror("tmpfile");
+		return 1;
+	}
+	printf("%s, %d samples per entry, %u levels\n", sc8 ? "sc8" : "sc16", base, levels);
+	printf("%zu M samples: %.1f MS/s on one core, %.2fx the %.2f MS/s maximum\n", n / 1000000, n / t / 1e6,
+		n / t / MAX_SAMPLERATE, MAX_SAMPLERATE / 1e6);
+	printf("whole stream: min %.2f max %.2f rms %.2f LSB\n", (double)top.min / PYR_SCALE, (double)top.max / PYR_SCALE,
+		(double)top.rms / PYR_SCALE);
+	fclose(fl);
+	free(buf);
+	return 0;
+}
+
+static int cmd_bench_spec(int argc, char **argv) {
+	const char *spec = (argc > 1) ? argv[1] : "4096";
+	double rate = (argc > 2) ? atof(argv[2]) * 1e6 : MAX_SAMPLERATE;
+	size_t n = (argc > 3) ? strtoull(argv[3], NULL, 10) * 1000000 : 64000000, block = 1 << 18;
+	struct spectro sp;
+	struct spec_header h;
+	char *mem;
+	size_t mem_len;
+	int16_t *buf;
+
+	if (spectro_parse(&sp, spec, rate, 4))
+		return 1;
+	n = (n + block - 1) / block * block;
+	FILE *fl = open_memstream(&mem, &mem_len);
+	if (!fl || !(buf = malloc(block * 4))) {
+		perror("malloc");
+		return 1;
+	}
+	// a near full scale tone on a bin, 0.2137 of the rate up, on a noise floor of a few LSB
+	int bins = sp.n, k = lrint(0.2137 * bins), bin = k + bins / 2, frames = sp.frames;
+	double f = (double)k / bins * rate, amp = 2047 - 8;
+	if (spectro_open(&sp, fl))
+		return 1;
+	double t = 0;
+	for (size_t ofs = 0; ofs < n; ofs += block) {
+		for (size_t i = 0; i < block; i++) {
+			double a = 2 * M_PI * fmod(f * (ofs + i) / rate, 1);
+			buf[2 * i] = lrint(amp * cos(a) + (rand() % 9) - 4);
+			buf[2 * i + 1] = lrint(amp * sin(a) + (rand() % 9) - 4);
+		}
+		double t0 = now();
+		spectro_run(&sp, buf, block, ofs);
+		t += now() - t0;
+	}
+	if (spectro_close(&sp))
+		return 1;
+
+	memcpy(&h, mem, sizeof(h));
+	size_t len = sizeof(struct spec_row) + 2 * (size_t)h.fft, rows = (mem_len - sizeof(h)) / len;
+	const uint8_t *row = (const uint8_t *)mem + sizeof(h) + (rows / 2) * len + sizeof(struct spec_row);
+	int floor_max = 0;
+	for (int i = 0; i < bins; i++) {
+		if (abs(i - bin) > 4)
+			floor_max = MAX(floor_max, row[i]);
+	}
+	printf("%d point FFT, %d frames per row (%.3f s at %.3f MS/s)\n", bins, frames, (double)bins * frames / rate, rate / 1e6);
+	printf("%zu M samples: %.1f MS/s on one core, %.2fx real time, %zu rows\n", n / 1000000, n / t / 1e6, n / t / rate, rows);
+	printf("tone %+.1f dBFS mean, %+.1f dBFS peak, highest other bin %+.1f dBFS\n", (row[bin] - 255) / 2.0,
+		(row[bins + bin] - 255) / 2.0, (floor_max - 255) / 2.0);
+	free(mem);
+	free(buf);
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*fn)(int argc, char **argv);
+	const char *help;
+} cmds[] = {
+	{ "unpack",     cmd_unpack,     "<in.p12> <out.iq>   packed12 to SC16" },
+	{ "info",       cmd_info,       "<in.iqz>            container summary" },
+	{ "cat",        cmd_cat,        "<in.iqz> <out.iq> [first [samples]]  decompress, seeks via the index" },
+	{ "unsquelch",  cmd_unsquelch,  "<in.iq> <out.iq> [sc8]  left out stretches back in as zeros, from <in.iq>.squelch" },
+	{ "resample",   cmd_resample,   "<in.iq> <out.iq> <in rate> <out rate>[:<pass>[:<dB>]] [sc8]  rational resampling to SC16" },
+	{ "spectrogram", cmd_spectrogram, "<in.iq> <out.spec> <rate> <fft>[:<seconds>] [sc8]  spectrogram sidecar like -W" },
+	{ "index",      cmd_index,      "<in.iq> <out.act> <rate> <bands> [<fft>[:<seconds>]] [sc8]  activity index like -A" },
+	{ "query",      cmd_query,      "<capture> <lo>:<hi> <threshold> [level|peak|occ [<out.iq>]]  time ranges with activity, from <capture>.act" },
+	{ "pyramid",    cmd_pyramid,    "<in.iq> <out.pyr> <rate> [<samples per entry>] [sc8]  magnitude pyramid like -M" },
+	{ "overview",   cmd_overview,   "<in.pyr> [<from s> <to s>] <points>  min/max/RMS trace from the pyramid alone" },
+	{ "waterfall",  cmd_waterfall,  "<in.spec> <out.pgm> [mean|peak [<width> [<height>]]]  render a spectrogram" },
+	{ "bench-codec", cmd_bench_codec, "<capture.iq> [codec ...]  block codecs on real data" },
+	{ "bench-pack", cmd_bench_pack, "[M samples]         packed12 kernel throughput" },
+	{ "bench-ddc",  cmd_bench_ddc,  "[<offset>:<rate>[:<pass>[:<dB>]] [<MS/s in> [M samples]]]  DDC throughput, default 1M:240k 61.44" },
+	{ "bench-pfb",  cmd_bench_pfb,  "[<channels>[:<list>] [<MS/s in> [M samples [os]]]]  PFB channelizer throughput, default 64 61.44" },
+	{ "bench-ols",  cmd_bench_ols,  "[<offset>:<bandwidth>[:<rate>][,...] [<MS/s in> [M samples]]]  overlap-save extraction throughput, default 4 channels 61.44" },
+	{ "bench-resamp", cmd_bench_resamp, "[<rate>[:<pass>[:<dB>]] [<MS/s in> [M samples]]]  resampler throughput, default 2.4M 61.44" },
+	{ "bench-pyr",  cmd_bench_pyr,  "[<samples per entry> [sc8 [M samples]]]  magnitude pyramid throughput, default 4096" },
+	{ "bench-spec", cmd_bench_spec, "[<fft>[:<seconds>] [<MS/s in> [M samples]]]  spectrogram throughput, default 4096 61.44" },
+};
+
+int main(int argc, char **argv) {
+	for (size_t i = 0; (argc > 1) && (i < sizeof(cmds) / sizeof(cmds[0])); i++) {
+		if (!strcmp(argv[1], cmds[i].name))
+			return cmds[i].fn(argc - 1, argv + 1);
+	}
+	fprintf(stderr, "Usage: %s <command> [args]\n", argv[0]);
+	for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++)
+		fprintf(stderr, "   %-10s %s\n", cmds[i].name, cmds[i].help);
+	return 1;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Random access reader for .iqz containers, see iqz.h */
+
+#define _FILE_OFFSET_BITS 64
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "iqz.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+static int read_at(struct iqz *z, void *dst, size_t len, uint64_t ofs) {
+	if (fseeko(z->fl, ofs, SEEK_SET) || (fread(dst, 1, len, z->fl) != len))
+		return -1;
+	return 0;
+}
+
+int iqz_open(struct iqz *z, const char *fn) {
+	memset(z, 0, sizeof(struct iqz));
+	z->cur = SIZE_MAX;
+	if (!(z->fl = fopen(fn, "rb"))) {
+		perror(fn);
+		return -1;
+	}
+	fseeko(z->fl, 0, SEEK_END);
+	z->file_size = ftello(z->fl);
+	if ((z->file_size < sizeof(struct iqz_header) + sizeof(struct iqz_tail)) ||
+		read_at(z, &z->hdr, sizeof(z->hdr), 0) || memcmp(z->hdr.magic, IQZ_MAGIC, 4) ||
+		read_at(z, &z->tail, sizeof(z->tail), z->file_size - sizeof(z->tail)) ||
+		memcmp(z->tail.magic, IQZ_TAIL_MAGIC, 8) || !z->hdr.block) {
+		fprintf(stderr, "%s: not an iqz container or index missing\n", fn);
+		iqz_close(z);
+		return -1;
+	}
+	z->index = malloc(z->tail.blocks * sizeof(uint64_t));
+	z->in = malloc(z->hdr.block);
+	z->out = malloc(z->hdr.block);
+	if (!z->index || !z->in || !z->out ||
+		read_at(z, z->index, z->tail.blocks * sizeof(uint64_t), z->tail.index)) {
+		fprintf(stderr, "%s: can't read the index\n", fn);
+		iqz_close(z);
+		return -1;
+	}
+	return 0;
+}
+
+/* decodes block k into z->out */
+static int load_block(struct iqz *z, size_t k, size_t *raw_len) {
+	struct iqz_block b;
+	const struct codec *c;
+
+	if (read_at(z, &b, sizeof(b), z->index[k]) || (b.raw_len > z->hdr.block) || (b.len > z->hdr.block))
+		return -1;
+	*raw_len = b.raw_len;
+	if (z->cur == k)
+		return 0;
+	z->cur = SIZE_MAX;
+	if (b.codec == CODEC_RAW) {
+		if (read_at(z, z->out, b.len, z->index[k] + sizeof(b)) || (b.len != b.raw_len))
+			return -1;
+	}
+	else if (!(c = codec_by_id(b.codec)) || read_at(z, z->in, b.len, z->index[k] + sizeof(b)) ||
+		c->decompress(z->out, b.raw_len, z->in, b.len)) {
+		fprintf(stderr, "block %zu: can't decode\n", k);
+		return -1;
+	}
+	z->cur = k;
+	return 0;
+}
+
+long iqz_read(struct iqz *z, void *dst, uint64_t pos, size_t len) {
+	uint8_t *p = dst;
+	while (len && (pos < z->tail.raw_size)) {
+		size_t k = pos / z->hdr.block, ofs = pos % z->hdr.block, raw_len, n;
+		if ((k >= z->tail.blocks) || load_block(z, k, &raw_len) || (ofs >= raw_len))
+			return -1;
+		n = MIN(len, raw_len - ofs);
+		memcpy(p, z->out + ofs, n);
+		p += n;
+		pos += n;
+		len -= n;
+	}
+	return p - (uint8_t *)dst;
+}
+
+void iqz_close(struct iqz *z) {
+	if (z->fl)
+		fclose(z->fl);
+	free(z->index);
+	free(z->in);
+	free(z->out);
+	memset(z, 0, sizeof(struct iqz));
+}
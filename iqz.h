@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IQZ_H
+#define IQZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Block compressed capture container. The raw stream is cut into blocks
+ * of header.block bytes (the last one may be shorter), each compressed on
+ * its own so any of them can be decoded without its predecessors:
+ *
+ *     iqz_header | iqz_block + data | ... | index | iqz_tail
+ *
+ * The index holds the file offset of every iqz_block, raw offset k * block
+ * lives in block k. All fields little endian.
+ */
+
+#define IQZ_MAGIC       "IQZ1"
+#define IQZ_TAIL_MAGIC  "IQZINDEX"
+#define IQZ_BLOCK       (4 << 20)   // raw bytes per block when capturing
+
+struct iqz_header {
+	char magic[4];
+	uint16_t version;      // 1
+	uint16_t ss;           // bytes per sample of the raw stream
+	uint32_t block;
+	uint32_t reserved[5];
+};
+
+struct iqz_block {
+	uint32_t len;          // stored bytes that follow
+	uint32_t raw_len;
+	uint8_t codec;         // enum codec_id
+	uint8_t reserved[7];
+};
+
+struct iqz_tail {
+	uint64_t index;        // file offset of the index
+	uint64_t blocks;
+	uint64_t raw_size;
+	char magic[8];
+};
+
+/* worst case file size for raw bytes of input (incompressible data is stored as is) */
+static inline size_t iqz_bound(size_t raw) {
+	size_t blocks = raw / IQZ_BLOCK + 1;
+	return raw + sizeof(struct iqz_header) + sizeof(struct iqz_tail) +
+		blocks * (sizeof(struct iqz_block) + sizeof(uint64_t));
+}
+
+enum codec_id {
+	CODEC_RAW = 0,
+	CODEC_ZSTD,
+	CODEC_LZ4,
+	CODEC_LPC,
+	CODEC_QUANT,
+};
+
+/*
+ * Block codecs. compress() returns the stored size, 0 if the result
+ * doesn't fit (the block is then stored raw). ctx is per thread.
+ */
+struct codec {
+	const char *name;
+	uint8_t id;
+	int level;             // default
+	void *(*ctx_new)(int level);
+	void (*ctx_free)(void *ctx);
+	size_t (*bound)(size_t len);
+	size_t (*compress)(void *ctx, void *dst, size_t cap, const void *src, size_t len);
+	int (*decompress)(void *dst, size_t len, const void *src, size_t n);   // 0: ok
+	size_t ss;             // only for streams of this sample size, 0: any
+	int lossy;
+};
+
+extern const struct codec codec_lpc, codec_quant;
+
+/* "name" or "name:level" */
+const struct codec *codec_parse(const char *spec, int *level);
+const struct codec *codec_by_id(int id);
+const char *codec_names(void);
+
+/* reader */
+struct iqz {
+	FILE *fl;
+	struct iqz_header hdr;
+	struct iqz_tail tail;
+	uint64_t *index;
+	size_t file_size;
+	uint8_t *in, *out;     // one block, stored and decoded
+	size_t cur;            // block in out, SIZE_MAX: none
+};
+
+int iqz_open(struct iqz *z, const char *fn);
+/* len raw bytes from raw offset pos, returns bytes read (short at the end) or -1 */
+long iqz_read(struct iqz *z, void *dst, uint64_t pos, size_t len);
+void iqz_close(struct iqz *z);
+
+#endif
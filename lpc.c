@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lossless codec for SC16 blocks, along the lines of FLAC: I and Q are
+ * coded separately in frames of FRAME samples. Every frame gets its own
+ * linear predictor (Levinson-Durbin on the frame's autocorrelation, the
+ * order picked by estimated size, coefficients in Q12), the residuals
+ * are Rice coded with one parameter per PART samples. Prediction runs
+ * across frame boundaries, a block starts from zeros.
+ *
+ * Frame, per channel:  order:4  coef:16 * order  { k:5  residuals } per part
+ * Residual u (zigzag): q = u >> k ones, a zero, the low k bits of u;
+ *                      q >= ESC: ESC ones and u in 32 bits.
+ * Bits are packed LSB first.
+ *
+ * Predictions are summed in 32 bits, which is exact as long as samples
+ * stay below PEAK (SC16 Q11 does). Frames with bigger values, history
+ * included, are coded with order 0.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "iqz.h"
+#include "bits.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define FRAME       4096
+#define PART        256
+#define MAX_ORDER   12
+#define SHIFT       12          // coefficient scale
+#define PEAK        4096
+#define ESC         24
+#define MAX_K       20
+
+/*
+ * The encoder's inner loops are written with vector types, so they are
+ * vectorized at -O2 too, and on x86 also built for AVX2 and picked at
+ * load time.
+ */
+typedef int32_t v8si __attribute__((vector_size(32)));
+
+#if defined(__x86_64__)
+#define MULTIVERSION    __attribute__((target_clones("avx2", "default")))
+#else
+#define MULTIVERSION
+#endif
+
+struct lpc {
+	int max_order;
+	size_t cap;             // samples per channel
+	int32_t *x[2];          // deinterleaved block, MAX_ORDER zeros in front
+	uint32_t *u;
+};
+
+/* Rice code, one fill is enough for the longest one, ESC + 32 bits */
+static inline uint32_t br_rice(struct br *r, int k) {
+	uint32_t v;
+	int q, len;
+
+	br_fill(r);
+	q = ~r->acc ? __builtin_ctzll(~r->acc) : 64;
+	if (q >= ESC) {
+		v = r->acc >> ESC;
+		len = ESC + 32;
+	}
+	else {
+		v = (q << k) | ((r->acc >> (q + 1)) & ((1U << k) - 1));
+		len = q + 1 + k;
+	}
+	r->acc >>= len;
+	r->n -= len;
+	return v;
+}
+
+/* encoder */
+
+static void *lpc_new(int level) {
+	struct lpc *c = calloc(1, sizeof(struct lpc));
+	if (!c)
+		return NULL;
+	c->max_order = (level < 0) ? 0 : MIN(level, MAX_ORDER);
+	c->cap = IQZ_BLOCK / 4;
+	c->x[0] = malloc((c->cap + MAX_ORDER) * sizeof(int32_t));
+	c->x[1] = malloc((c->cap + MAX_ORDER) * sizeof(int32_t));
+	c->u = malloc(FRAME * sizeof(uint32_t));
+	if (!c->x[0] || !c->x[1] || !c->u) {
+		free(c->x[0]);
+		free(c->x[1]);
+		free(c->u);
+		free(c);
+		return NULL;
+	}
+	memset(c->x[0], 0, MAX_ORDER * sizeof(int32_t));
+	memset(c->x[1], 0, MAX_ORDER * sizeof(int32_t));
+	c->x[0] += MAX_ORDER;
+	c->x[1] += MAX_ORDER;
+	return c;
+}
+
+static void lpc_free(void *ctx) {
+	struct lpc *c = ctx;
+	free(c->x[0] - MAX_ORDER);
+	free(c->x[1] - MAX_ORDER);
+	free(c->u);
+	free(c);
+}
+
+static size_t lpc_bound(size_t len) {
+	// anything bigger is stored raw anyway
+	return len + 1024;
+}
+
+/* r[0..p], exact: products stay below 2^24, so 127 of them fit a 32 bit lane */
+MULTIVERSION
+static void autocorr(const int32_t *x, size_t m, int p, double *r) {
+	for (int k = 0; k <= p; k++) {
+		int64_t sum = 0;
+		size_t i = k;
+		while (i + 8 <= m) {
+			v8si acc = {0};
+			for (int j = 0; (j < 127) && (i + 8 <= m); j++, i += 8) {
+				v8si a, b;
+				memcpy(&a, x + i, sizeof(a));
+				memcpy(&b, x + i - k, sizeof(b));
+				acc += a * b;
+			}
+			for (int l = 0; l < 8; l++)
+				sum += acc[l];
+		}
+		for (; i < m; i++)
+			sum += x[i] * x[i - k];
+		r[k] = sum;
+	}
+}
+
+/* zigzagged residuals of m samples at x */
+MULTIVERSION
+static void residuals(uint32_t *u, const int32_t *x, size_t m, const int32_t *q, int order) {
+	size_t i = 0;
+	for (; i + 8 <= m; i += 8) {
+		v8si acc = {0}, v, e;
+		for (int k = 1; k <= order; k++) {
+			memcpy(&v, x + i - k, sizeof(v));
+			acc += q[k] * v;
+		}
+		memcpy(&v, x + i, sizeof(v));
+		e = v - (acc >> SHIFT);
+		e = (e << 1) ^ (e >> 31);
+		memcpy(u + i, &e, sizeof(e));
+	}
+	for (; i < m; i++) {
+		int32_t acc = 0, e;
+		for (int k = 1; k <= order; k++)
+			acc += q[k] * x[i - k];
+		e = x[i] - (acc >> SHIFT);
+		u[i] = ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+	}
+}
+
+/* predictor for m samples at x, returns the order, coefficients in q[1..order] */
+static int lpc_fit(struct lpc *c, const int32_t *x, size_t m, int32_t *q) {
+	double r[MAX_ORDER + 1], a[MAX_ORDER + 1] = {0}, tmp[MAX_ORDER + 1];
+	double err, best_cost;
+	int32_t peak = 0;
+	int p = c->max_order, best = 0;
+
+	for (ptrdiff_t i = -MAX_ORDER; i < (ptrdiff_t)m; i++)
+		peak |= abs(x[i]);
+	if (!p || (peak >= PEAK) || (m <= (size_t)p))
+		return 0;
+
+	autocorr(x, m, p, r);
+	if (r[0] <= 0)
+		return 0;
+
+	// Levinson-Durbin, about 0.5 * log2(error) bits per sample plus the coefficients
+	err = r[0];
+	best_cost = 0.5 * m * log2(fmax(err / m, 1));
+	for (int i = 1; i <= p; i++) {
+		double acc = r[i];
+		for (int j = 1; j < i; j++)
+			acc -= a[j] * r[i - j];
+		double k = acc / err;
+		for (int j = 1; j < i; j++)
+			tmp[j] = a[j] - k * a[i - j];
+		memcpy(a + 1, tmp + 1, (i - 1) * sizeof(double));
+		a[i] = k;
+		err *= 1 - k * k;
+		if (err <= 0)
+			break;
+		double cost = 0.5 * m * log2(fmax(err / m, 1)) + 16 * i;
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = i;
+			for (int j = 1; j <= i; j++) {
+				long v = lrint(a[j] * (1 << SHIFT));
+				q[j] = (v > 32767) ? 32767 : (v < -32767) ? -32767 : v;
+			}
+		}
+	}
+	return best;
+}
+
+static void encode_frame(struct lpc *c, struct bw *w, const int32_t *x, size_t m) {
+	int32_t q[MAX_ORDER + 1];
+	int order = lpc_fit(c, x, m, q);
+
+	residuals(c->u, x, m, q, order);
+	bw_put(w, order, 4);
+	for (int k = 1; k <= order; k++)
+		bw_put(w, (uint16_t)q[k], 16);
+	for (size_t ofs = 0; ofs < m; ofs += PART) {
+		size_t n = MIN((size_t)PART, m - ofs);
+		uint64_t sum = 0;
+		int k = 0;
+		for (size_t i = 0; i < n; i++)
+			sum += c->u[ofs + i];
+		while ((k < MAX_K) && ((uint64_t)n << (k + 1)) < sum)
+			k++;
+		bw_put(w, k, 5);
+		for (size_t i = 0; i < n; i++) {
+			uint32_t u = c->u[ofs + i], hi = u >> k;
+			if (hi >= ESC) {
+				bw_put(w, (1 << ESC) - 1, ESC);
+				bw_put(w, u, 32);
+				continue;
+			}
+			// hi ones, a zero, k bits
+			uint32_t low = u & ((1 << k) - 1);
+			if (hi + 1 + k <= 32)
+				bw_put(w, ((1 << hi) - 1) | low << (hi + 1), hi + 1 + k);
+			else {
+				bw_put(w, (1 << hi) - 1, hi + 1);
+				bw_put(w, low, k);
+			}
+		}
+	}
+}
+
+static size_t lpc_compress(void *ctx, void *dst, size_t cap, const void *src, size_t len) {
+	struct lpc *c = ctx;
+	const int16_t *iq = src;
+	size_t n = len / 4;
+	struct bw w = {.p = dst, .end = (uint8_t *)dst + cap};
+
+	if ((len % 4) || (n > c->cap))
+		return 0;
+	for (size_t i = 0; i < n; i++) {
+		c->x[0][i] = iq[2 * i];
+		c->x[1][i] = iq[2 * i + 1];
+	}
+	for (size_t f = 0; f < n && !w.full; f += FRAME) {
+		encode_frame(c, &w, c->x[0] + f, MIN((size_t)FRAME, n - f));
+		encode_frame(c, &w, c->x[1] + f, MIN((size_t)FRAME, n - f));
+	}
+	return bw_finish(&w, dst);
+}
+
+/* decoder */
+
+static void decode_frame(struct br *r, int16_t *iq, size_t f, size_t m) {
+	int32_t q[MAX_ORDER + 1];
+	int order = br_get(r, 4);
+
+	order = MIN(order, MAX_ORDER);
+	for (int k = 1; k <= order; k++)
+		q[k] = (int16_t)br_get(r, 16);
+	for (size_t ofs = 0; ofs < m; ofs += PART) {
+		size_t n = MIN((size_t)PART, m - ofs);
+		int k = br_get(r, 5);
+		k = MIN(k, MAX_K);
+		for (size_t i = f + ofs; i < f + ofs + n; i++) {
+			uint32_t u = br_rice(r, k);
+			int32_t e = (int32_t)(u >> 1) ^ -(int32_t)(u & 1), acc = 0;
+			if (i >= (size_t)order) {
+				for (int j = 1; j <= order; j++)
+					acc += q[j] * iq[2 * (i - j)];
+			}
+			else {
+				for (int j = 1; j <= (int)i; j++)
+					acc += q[j] * iq[2 * (i - j)];
+			}
+			iq[2 * i] = e + (acc >> SHIFT);
+		}
+	}
+}
+
+static int lpc_decompress(void *dst, size_t len, const void *src, size_t n) {
+	struct br r = {.p = src, .end = (const uint8_t *)src + n};
+	int16_t *iq = dst;
+	size_t samples = len / 4;
+
+	if (len % 4)
+		return -1;
+	for (size_t f = 0; f < samples; f += FRAME) {
+		decode_frame(&r, iq, f, MIN((size_t)FRAME, samples - f));
+		decode_frame(&r, iq + 1, f, MIN((size_t)FRAME, samples - f));
+	}
+	return br_ok(&r) ? 0 : -1;
+}
+
+const struct codec codec_lpc = {
+	.name       = "lpc",
+	.id         = CODEC_LPC,
+	.level      = 8,
+	.ctx_new    = lpc_new,
+	.ctx_free   = lpc_free,
+	.bound      = lpc_bound,
+	.compress   = lpc_compress,
+	.decompress = lpc_decompress,
+	.ss         = 4,
+};
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * RAM ring sink: the stream goes into anonymous memory that keeps the
+ * last size bytes and never touches the disk. When the trigger fires, a
+ * dump thread writes the ring's history from up to pre bytes before the
+ * trigger on to post bytes after it into a new file from the pattern,
+ * numbered by event. The trigger is rearmed right away: one that fires
+ * during the dump extends it by its own post window, as long as that ends
+ * within one ring length of the first trigger. A trigger past that starts
+ * the next event, so a trigger that keeps firing gives a dump per ring
+ * length. Each trigger gets a line in <basename>.events.
+ *
+ * The dump reads the ring while RX keeps writing into it. It starts at
+ * least slack bytes behind the oldest byte RX may overwrite next, which
+ * is its head start; if the disk can't keep up with the stream it loses
+ * that, the dump ends there and is marked as overrun.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <limits.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "storage.h"
+#include "trigger.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b)    ((a)>=(b)?(a):(b))
+#endif
+
+#define DUMP_CHUNK      (4UL << 20)
+#define DUMP_POLL_NS    1000000
+
+struct memring {
+	uint8_t *mem;
+	size_t size, alloc;         // ring bytes, mapped bytes
+	_Atomic size_t head;        // stream bytes in the ring
+	_Atomic size_t claim;       // ... plus those being received into it
+	size_t ss, pre, post, slack;
+	struct trigger *trig;
+	int backend;
+	const char *pattern;
+	FILE *list;
+	size_t last_end;            // a dump never repeats the previous one's bytes
+	_Atomic unsigned events;
+	_Atomic int dumping, stop;
+	pthread_t thread;
+	int running;
+	size_t dumped;              // bytes in all dumps
+	unsigned *events_out;
+	size_t *stored;
+};
+
+/* RX may have written over stream bytes from pos on */
+static int lapped(struct memring *m, size_t pos) {
+	atomic_thread_fence(memory_order_seq_cst);
+	return atomic_load(&m->claim) > pos + m->size;
+}
+
+/* a trigger that fires during a dump and whose window ends by limit extends it, *end is moved */
+static void dump_merge(struct memring *m, unsigned idx, const char *fn, size_t *end, size_t limit) {
+	struct trigger *t = m->trig;
+	size_t pos = t->pos - t->pos % m->ss;
+
+	// stays latched and starts the next event once this one is written
+	if (pos + m->post > limit)
+		return;
+	*end = MAX(*end, pos + m->post);
+	fprintf(m->list, "%u %s %zu %s - - - merged\n", idx, fn, pos / m->ss, t->cause);
+	trigger_rearm(t);
+}
+
+static void dump_event(struct memring *m, unsigned idx) {
+	struct timespec ts = {.tv_nsec = DUMP_POLL_NS};
+	struct trigger *t = m->trig;
+	const char *cause = t->cause;
+	size_t pos = t->pos - t->pos % m->ss, end = pos + m->post, claim = atomic_load(&m->claim);
+	size_t want = MAX((pos > m->pre) ? pos - m->pre : 0, m->last_end), from = want, cur;
+	const char *how = "complete";
+	char fn[PATH_MAX];
+	struct sink out;
+
+	// later triggers are taken while this one is written
+	trigger_rearm(t);
+	// history RX is about to overwrite is left out
+	if (claim + m->slack > m->size)
+		from = MAX(from, claim + m->slack - m->size);
+	snprintf(fn, sizeof(fn), m->pattern, idx);
+	// fired within what the last dump already covers, nothing new to write
+	if (from >= end) {
+		fprintf(m->list, "%u - %zu %s %zu %zu 0 dumped\n", idx, pos / m->ss, cause, want / m->ss, from / m->ss);
+		fflush(m->list);
+		return;
+	}
+	// merged triggers extend the dump up to one ring length past the first; the file is cut to size on close
+	const size_t limit = MAX(end, pos + m->size);
+	if (sink_open(&out, m->backend, fn, limit - from, 0)) {
+		fprintf(stderr, "\nRAM ring: no dump of event %u (%s)\n", idx, cause);
+		return;
+	}
+	for (cur = from; cur < end; ) {
+		size_t head = atomic_load(&m->head), ofs = cur % m->size, n;
+		void *dst;
+		if (trigger_fired(t))
+			dump_merge(m, idx, fn, &end, limit);
+		if (head <= cur) {
+			if (atomic_load(&m->stop)) {
+				how = "stopped";
+				break;
+			}
+			nanosleep(&ts, NULL);
+			continue;
+		}
+		n = MIN(MIN(head, end) - cur, MIN(m->size - ofs, DUMP_CHUNK));
+		if (sink_get(&out, &dst, &n) || !n)
+			break;
+		memcpy(dst, m->mem + ofs, n);
+		// the copy only counts if none of it was overwritten meanwhile
+		if (lapped(m, cur)) {
+			how = "overrun";
+			break;
+		}
+		if (sink_put(&out, n))
+			break;
+		cur += n;
+	}
+	sink_close(&out);
+	m->dumped += cur - from;
+	if (cur < end && !strcmp(how, "complete"))
+		how = "failed";
+	else if (from > want && !strcmp(how, "complete"))
+		how = "truncated";
+	fprintf(m->list, "%u %s %zu %s %zu %zu %zu %s\n", idx, fn, pos / m->ss, cause, want / m->ss,
+		from / m->ss, (cur - from) / m->ss, how);
+	fflush(m->list);
+	m->last_end = cur;
+}
+
+static void *dump_thread(void *arg) {
+	struct memring *m = arg;
+	struct timespec ts = {.tv_nsec = DUMP_POLL_NS};
+
+	// a trigger that fired just before the stop still gets its dump
+	for (;;) {
+		if (trigger_fired(m->trig)) {
+			atomic_store(&m->dumping, 1);
+			dump_event(m, atomic_load(&m->events));
+			atomic_fetch_add(&m->events, 1);
+			atomic_store(&m->dumping, 0);
+		}
+		else if (atomic_load(&m->stop))
+			break;
+		else
+			nanosleep(&ts, NULL);
+	}
+	return NULL;
+}
+
+static int memring_get(struct sink *s, void **dst, size_t *len) {
+	struct memring *m = s->priv;
+	*len = MIN(*len, sink_space(s));
+	*dst = m->mem + sink_pos(s);
+	// published before RX writes, the dump checks it after reading
+	atomic_store(&m->claim, s->written + *len);
+	atomic_thread_fence(memory_order_seq_cst);
+	return 0;
+}
+
+static int memring_put(struct sink *s, size_t len) {
+	struct memring *m = s->priv;
+	s->written += len;
+	atomic_store(&m->head, s->written);
+	return 0;
+}
+
+static void memring_close(struct sink *s) {
+	struct memring *m = s->priv;
+	atomic_store(&m->stop, 1);
+	if (m->running)
+		pthread_join(m->thread, NULL);
+	*m->events_out = atomic_load(&m->events);
+	*m->stored = m->dumped;
+	if (m->list)
+		fclose(m->list);
+	buf_free(m->mem, m->alloc);
+	free(m);
+}
+
+static const struct sink_ops memring_ops = {
+	.name  = "RAM ring",
+	.get   = memring_get,
+	.put   = memring_put,
+	.close = memring_close,
+};
+
+int sink_open_memring(struct sink *s, int backend, const char *pattern, size_t size,
+	struct trigger *trig, size_t post, unsigned *events, size_t *stored)
+{
+	struct memring *m = calloc(1, sizeof(struct memring));
+	char base[PATH_MAX];
+
+	if (!m) {
+		perror("RAM ring");
+		return -1;
+	}
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &memring_ops;
+	s->ss = sink_sample_size;
+	s->size = size & ~(size_t)(4096 - 1);
+	s->ring = 1;
+	s->priv = m;
+	m->size = m->alloc = s->size;
+	m->ss = s->ss;
+	m->slack = s->size / 8 / 4096 * 4096;
+	m->pre = s->size - m->slack;
+	m->post = post - post % m->ss;
+	m->trig = trig;
+	m->events_out = events;
+	m->stored = stored;
+	m->backend = backend;
+	m->pattern = pattern;
+	segment_basename(base, sizeof(base), pattern);
+	if (!m->size || !(m->mem = buf_alloc(&m->alloc, "RAM ring")) || !(m->list = sidecar_open(base, "events"))) {
+		memring_close(s);
+		return -1;
+	}
+	fprintf(m->list, "# event file trigger_sample cause requested_first first_sample samples status\n");
+	fprintf(m->list, "# complete, truncated (history lost before first_sample), stopped, overrun, failed,\n");
+	fprintf(m->list, "# merged (fired during the dump of that event number and extends it), dumped (already in the last one)\n");
+	fflush(m->list);
+	m->running = !pthread_create(&m->thread, NULL, dump_thread, m);
+	if (!m->running) {
+		perror("pthread_create");
+		memring_close(s);
+		return -1;
+	}
+	return 0;
+}
+
+void sink_memring_stats(struct sink *s, unsigned *events, int *dumping) {
+	struct memring *m = s->priv;
+	*events = atomic_load(&m->events);
+	*dumping = atomic_load(&m->dumping);
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every FFT covers n samples starting at b, the last step of them new.
+ * With the spectrum X, a channel centered on bin k keeps the nbins = n / d
+ * bins around it, weighted by the filter spectrum H:
+ *
+ *   z = IFFT_nbins(X[k + i] * H[i]),  -nbins/2 <= i < nbins/2
+ *
+ * z[j] is the filtered input at b + j * d, mixed down by k / n turns per
+ * sample counted from b, and wrapped around for j * d < taps - 1. The
+ * wrapped ones fall into the first hist = n / 4 samples, which the
+ * previous FFT already covered, so z[hist / d ..] are kept and turned by
+ * exp(-j 2 pi k b / n) to count from sample 0.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ols.h"
+
+#define OLS_ATTEN   80          // channel filter stopband, dB
+
+struct ols_scratch {
+	float *re, *im;
+	float *xr, *xi;             // FFT of n
+	float *zr, *zi;             // a channel's bins
+	float *yr, *yi;             // outputs, a row per channel
+	size_t row[OLS_MAX_CH];
+	struct fft fft, ifft[OLS_MAX_CH];
+};
+
+/* default: the lowest rate / 2^k at least 1.25 times the bandwidth */
+static int ols_decim(struct ols_chan *c, double rate) {
+	long d = 1;
+
+	if (c->out_rate <= 0) {
+		while (rate / (2 * d) >= 1.25 * c->bw)
+			d *= 2;
+		c->out_rate = rate / d;
+	}
+	d = lrint(rate / c->out_rate);
+	if ((d < 1) || (d & (d - 1)) || (fabs(d * c->out_rate - rate) > 1e-6 * rate)) {
+		fprintf(stderr, "OLS: output rate must be the input rate divided by a power of 2\n");
+		return -1;
+	}
+	if ((c->bw <= 0) || (c->bw >= c->out_rate)) {
+		fprintf(stderr, "OLS: bandwidth must be below the output rate\n");
+		return -1;
+	}
+	if (fabs(c->offset) + c->bw / 2 > rate / 2) {
+		fprintf(stderr, "OLS: channel at %.0f Hz is outside the captured band\n", c->offset);
+		return -1;
+	}
+	c->decim = d;
+	return 0;
+}
+
+/* passband to half the output rate less half a bin, the bins kept are cut off there */
+static int ols_taps(const struct ols_chan *c, double rate, int n) {
+	double pass = c->bw / 2 / rate, stop = (c->out_rate - rate / n) / 2 / rate;
+	return (stop > pass) ? fir_kaiser_len(pass, stop, OLS_ATTEN) : n;
+}
+
+/* smallest n that has room for every filter in the overlap */
+static int ols_size(const struct ols *o) {
+	for (int n = 1024; n <= OLS_MAX_FFT; n *= 2) {
+		int ok = 1;
+		for (int i = 0; i < o->nch; i++) {
+			const struct ols_chan *c = &o->ch[i];
+			ok &= (4 * c->decim <= n) && (ols_taps(c, o->rate, n) - 1 <= n / 4);
+		}
+		if (ok)
+			return n;
+	}
+	return 0;
+}
+
+/* spectrum of the lowpass shifted by the offset's fraction of a bin */
+static int ols_filter(struct ols_chan *c, struct fft *f, double rate) {
+	int n = f->n, k = c->nbins;
+	double frac = c->offset * n / rate - c->bin;
+	float *h = malloc(c->taps * sizeof(float));
+	float *re = calloc(n, sizeof(float)), *im = calloc(n, sizeof(float));
+	int res = -1;
+
+	c->h_re = malloc(k * sizeof(float));
+	c->h_im = malloc(k * sizeof(float));
+	if (!h || !re || !im || !c->h_re || !c->h_im)
+		goto out;
+	fir_kaiser_lowpass(h, c->taps, c->bw / 2 / rate, (c->out_rate - rate / n) / 2 / rate, OLS_ATTEN);
+	for (int t = 0; t < c->taps; t++) {
+		re[t] = h[t] * cos(2 * M_PI * frac * t / n);
+		im[t] = h[t] * sin(2 * M_PI * frac * t / n);
+	}
+	fft_run(f, re, im, 0);
+	for (int i = 0; i < k; i++) {
+		int b = (i < k / 2) ? i : n - k + i;
+		c->h_re[i] = re[b] / n;
+		c->h_im[i] = im[b] / n;
+	}
+	nco_init(&c->nco, -(c->offset - c->bin * rate / n), c->out_rate);
+	res = 0;
+out:
+	free(h);
+	free(re);
+	free(im);
+	return res;
+}
+
+int ols_parse(struct ols *o, const char *spec, double rate, size_t ss) {
+	struct fft f;
+	char *end;
+
+	memset(o, 0, sizeof(struct ols));
+	o->rate = rate;
+	o->ss = ss;
+	for (const char *q = spec; ; q = end + 1) {
+		struct ols_chan *c = &o->ch[o->nch];
+		if (o->nch == OLS_MAX_CH) {
+			fprintf(stderr, "OLS: at most %d channels\n", OLS_MAX_CH);
+			return -1;
+		}
+		c->offset = parse_freq(q, &end);
+		if ((end == q) || (*end != ':'))
+			goto fail;
+		c->bw = parse_freq(end + 1, &end);
+		if (*end == ':')
+			c->out_rate = parse_freq(end + 1, &end);
+		if (*end && (*end != ','))
+			goto fail;
+		if (ols_decim(c, rate))
+			return -1;
+		o->nch++;
+		if (!*end)
+			break;
+	}
+
+	if (!(o->n = ols_size(o))) {
+		fprintf(stderr, "OLS: a channel is too narrow for a %d point FFT, use the DDC\n", OLS_MAX_FFT);
+		return -1;
+	}
+	o->step = o->n / 4 * 3;
+	o->hist = o->n - o->step;
+	if (fft_init(&f, o->n)) {
+		perror("OLS");
+		return -1;
+	}
+	for (int i = 0; i < o->nch; i++) {
+		struct ols_chan *c = &o->ch[i];
+		c->taps = ols_taps(c, rate, o->n);
+		c->bin = lrint(c->offset * o->n / rate);
+		c->nbins = o->n / c->decim;
+		if (ols_filter(c, &f, rate)) {
+			perror("OLS");
+			fft_free(&f);
+			ols_free(o);
+			return -1;
+		}
+	}
+	fft_free(&f);
+	return 0;
+
+fail:
+	fprintf(stderr, "OLS: bad spec %s\n", spec);
+	return -1;
+}
+
+void ols_free(struct ols *o) {
+	for (int i = 0; i < o->nch; i++) {
+		free(o->ch[i].h_re);
+		free(o->ch[i].h_im);
+	}
+	memset(o, 0, sizeof(struct ols));
+}
+
+void *ols_scratch_new(const struct ols *o, size_t len) {
+	struct ols_scratch *sc = calloc(1, sizeof(struct ols_scratch));
+	size_t frames = (len + o->step - 1) / o->step, rows = 0;
+	int err = 0;
+
+	if (!sc)
+		return NULL;
+	for (int i = 0; i < o->nch; i++) {
+		sc->row[i] = rows;
+		rows += frames * o->step / o->ch[i].decim;
+		err |= fft_init(&sc->ifft[i], o->ch[i].nbins);
+	}
+	sc->re = malloc((o->hist + frames * o->step) * sizeof(float));
+	sc->im = malloc((o->hist + frames * o->step) * sizeof(float));
+	sc->xr = malloc(o->n * sizeof(float));
+	sc->xi = malloc(o->n * sizeof(float));
+	sc->zr = malloc(o->n * sizeof(float));
+	sc->zi = malloc(o->n * sizeof(float));
+	sc->yr = malloc(rows * sizeof(float));
+	sc->yi = malloc(rows * sizeof(float));
+	if (err || !sc->re || !sc->im || !sc->xr || !sc->xi || !sc->zr || !sc->zi || !sc->yr || !sc->yi ||
+			fft_init(&sc->fft, o->n)) {
+		ols_scratch_free(sc);
+		return NULL;
+	}
+	return sc;
+}
+
+void ols_scratch_free(void *scratch) {
+	struct ols_scratch *sc = scratch;
+	free(sc->re);
+	free(sc->im);
+	free(sc->xr);
+	free(sc->xi);
+	free(sc->zr);
+	free(sc->zi);
+	free(sc->yr);
+	free(sc->yi);
+	fft_free(&sc->fft);
+	for (int i = 0; i < OLS_MAX_CH; i++)
+		fft_free(&sc->ifft[i]);
+	free(sc);
+}
+
+void ols_run(const struct ols *o, void *scratch, const void *in, size_t len, uint64_t start,
+	int16_t *out, const size_t *ofs)
+{
+	struct ols_scratch *sc = scratch;
+	size_t frames = (len + o->step - 1) / o->step, n = o->hist + len;
+	int mask = o->n - 1;
+
+	// a short last block is padded with zeros
+	iq_to_float(sc->re, sc->im, in, n, o->ss);
+	memset(sc->re + n, 0, (frames * o->step - len) * sizeof(float));
+	memset(sc->im + n, 0, (frames * o->step - len) * sizeof(float));
+
+	for (size_t f = 0; f < frames; f++) {
+		int64_t b = (int64_t)(start + f * o->step) - o->hist;
+		memcpy(sc->xr, sc->re + f * o->step, o->n * sizeof(float));
+		memcpy(sc->xi, sc->im + f * o->step, o->n * sizeof(float));
+		fft_run(&sc->fft, sc->xr, sc->xi, 0);
+
+		for (int i = 0; i < o->nch; i++) {
+			const struct ols_chan *c = &o->ch[i];
+			int k = c->nbins, skip = o->hist / c->decim, cnt = o->step / c->decim;
+			double a = -2 * M_PI * (((uint64_t)c->bin * (uint64_t)b) & mask) / o->n;
+			float rc = cos(a), rs = sin(a);
+			float *yr = sc->yr + sc->row[i] + f * cnt, *yi = sc->yi + sc->row[i] + f * cnt;
+
+			for (int j = 0; j < k; j++) {
+				int q = (c->bin + ((j < k / 2) ? j : j - k)) & mask;
+				sc->zr[j] = sc->xr[q] * c->h_re[j] - sc->xi[q] * c->h_im[j];
+				sc->zi[j] = sc->xr[q] * c->h_im[j] + sc->xi[q] * c->h_re[j];
+			}
+			fft_run(&sc->ifft[i], sc->zr, sc->zi, 1);
+			for (int j = 0; j < cnt; j++) {
+				yr[j] = sc->zr[skip + j] * rc - sc->zi[skip + j] * rs;
+				yi[j] = sc->zr[skip + j] * rs + sc->zi[skip + j] * rc;
+			}
+		}
+	}
+
+	for (int i = 0; i < o->nch; i++) {
+		const struct ols_chan *c = &o->ch[i];
+		size_t cnt = (len + c->decim - 1) / c->decim;
+		float *yr = sc->yr + sc->row[i], *yi = sc->yi + sc->row[i];
+		nco_mix(&c->nco, yr, yi, cnt, start / c->decim);
+		float_to_sc16(out + 2 * ofs[i], yr, yi, cnt);
+	}
+}
+
+void ols_describe(const struct ols *o, FILE *fl, const char *pattern) {
+	fprintf(fl, "# SC16 per channel at its out_rate, input full scale = 32767, centered on the offset\n");
+	fprintf(fl, "# output sample m is input sample m * decimation - delay\n");
+	fprintf(fl, "# channel <index> <offset> <bandwidth> <out_rate> <decimation> <taps> <delay> <file>\n");
+	fprintf(fl, "in_rate %.0f\n", o->rate);
+	fprintf(fl, "fft %d step %d\n", o->n, o->step);
+	fprintf(fl, "stopband_db %d\n", OLS_ATTEN);
+	for (int i = 0; i < o->nch; i++) {
+		const struct ols_chan *c = &o->ch[i];
+		fprintf(fl, "channel %d %.0f %.0f %.0f %d %d %.1f ", i, c->offset, c->bw, c->out_rate,
+			c->decim, c->taps, (c->taps - 1) / 2.0);
+		fprintf(fl, pattern, i);
+		fputc('\n', fl);
+	}
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OLS_H
+#define OLS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsp.h"
+
+/*
+ * Overlap-save channel extraction: a list of channels, each with its own
+ * offset, bandwidth and output rate, cut out of the band in the frequency
+ * domain. One forward FFT of n points per step new samples is shared by
+ * all channels; each then costs a multiply over its own bins and an
+ * inverse FFT of n / decim points, so adding a narrow channel is cheap.
+ *
+ * Output rates are the input rate over a power of 2. The channel filter
+ * is a Kaiser lowpass from the bandwidth to half the output rate, applied
+ * as its spectrum, centered on the exact offset; what's left after
+ * picking the bin nearest to it is mixed out with an NCO at the output
+ * rate. Outputs are SC16 at full scale 32767 like the DDC's.
+ *
+ * Blocks work like ddc_run()'s, with hist = n - step and every block
+ * starting on a multiple of step.
+ */
+
+#define OLS_MAX_CH      32
+#define OLS_MAX_FFT     (1 << 20)
+
+struct ols_chan {
+	double offset, bw, out_rate;
+	int decim, taps;
+	int bin, nbins;             // bin nearest to the offset, bins kept (n / decim)
+	float *h_re, *h_im;         // filter spectrum over the kept bins, DC first, scaled by 1 / n
+	struct nco nco;             // the rest of the offset, at the output rate
+};
+
+struct ols {
+	double rate;
+	size_t ss;
+	int n, step;                // FFT size, new samples per FFT
+	int nch;
+	struct ols_chan ch[OLS_MAX_CH];
+	size_t hist;
+};
+
+/* <offset>:<bandwidth>[:<out_rate>][,...], k/M suffixes; the output rate
+ * defaults to the lowest rate / 2^k at least 1.25 times the bandwidth */
+int  ols_parse(struct ols *o, const char *spec, double rate, size_t ss);
+void ols_free(struct ols *o);
+
+void *ols_scratch_new(const struct ols *o, size_t len);
+void ols_scratch_free(void *scratch);
+
+/* in: hist + len samples, start a multiple of step; channel i's
+ * ceil(len / decim) outputs go to out + ofs[i] samples */
+void ols_run(const struct ols *o, void *scratch, const void *in, size_t len, uint64_t start,
+	int16_t *out, const size_t *ofs);
+
+/* key value lines for a metadata sidecar, pattern: printf pattern of the channel files */
+void ols_describe(const struct ols *o, FILE *fl, const char *pattern);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * 12 bit packing kernels. The SIMD versions build each sample's 24 bit
+ * word in a 32 bit lane and then drop every 4th byte with a byte shuffle
+ * (the reverse for unpacking). Vector stores and loads are 4 resp. 8
+ * bytes wider than the data they carry, so the loops stop early enough
+ * to stay inside the buffers and the scalar code does the rest.
+ * x86 kernels are compiled with target attributes and picked at runtime,
+ * no special compiler flags needed.
+ */
+
+#include <string.h>
+
+#include "pack12.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACK12_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define PACK12_NEON
+#endif
+
+static int always(void) {
+	return 1;
+}
+
+static void pack_c(uint8_t *dst, const int16_t *iq, size_t n) {
+	for (size_t i = 0; i < n; i++, iq += 2, dst += 3) {
+		uint32_t w = (iq[0] & 0xfff) | (uint32_t)(iq[1] & 0xfff) << 12;
+		dst[0] = w;
+		dst[1] = w >> 8;
+		dst[2] = w >> 16;
+	}
+}
+
+static void unpack_c(int16_t *iq, const uint8_t *src, size_t n) {
+	for (size_t i = 0; i < n; i++, iq += 2, src += 3) {
+		uint32_t w = src[0] | src[1] << 8 | src[2] << 16;
+		// move the sign bit to bit 15, shift back arithmetically
+		iq[0] = (int16_t)(w << 4) >> 4;
+		iq[1] = (int16_t)((w >> 8) & 0xfff0) >> 4;
+	}
+}
+
+#ifdef PACK12_X86
+
+__attribute__((target("ssse3")))
+static void pack_ssse3(uint8_t *dst, const int16_t *iq, size_t n) {
+	const __m128i lo = _mm_set1_epi32(0x00000fff), hi = _mm_set1_epi32(0x00fff000);
+	const __m128i shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	for (; n >= 6; n -= 4, iq += 8, dst += 12) {
+		__m128i x = _mm_loadu_si128((const __m128i *)iq);
+		__m128i w = _mm_or_si128(_mm_and_si128(x, lo), _mm_and_si128(_mm_srli_epi32(x, 4), hi));
+		_mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(w, shuf));
+	}
+	pack_c(dst, iq, n);
+}
+
+__attribute__((target("ssse3")))
+static void unpack_ssse3(int16_t *iq, const uint8_t *src, size_t n) {
+	// 16 bit lanes: I in the low 12 bits of bytes 0-1, Q in the high 12 bits of bytes 1-2
+	const __m128i shuf = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	const __m128i ilane = _mm_set1_epi32(0x0000ffff);
+	for (; n >= 6; n -= 4, iq += 8, src += 12) {
+		__m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), shuf);
+		__m128i i = _mm_srai_epi16(_mm_slli_epi16(x, 4), 4);
+		__m128i q = _mm_srai_epi16(x, 4);
+		_mm_storeu_si128((__m128i *)iq, _mm_or_si128(_mm_and_si128(ilane, i), _mm_andnot_si128(ilane, q)));
+	}
+	unpack_c(iq, src, n);
+}
+
+static int has_ssse3(void) {
+	return __builtin_cpu_supports("ssse3");
+}
+
+__attribute__((target("avx2")))
+static void pack_avx2(uint8_t *dst, const int16_t *iq, size_t n) {
+	const __m256i lo = _mm256_set1_epi32(0x00000fff), hi = _mm256_set1_epi32(0x00fff000);
+	const __m256i shuf = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	for (; n >= 11; n -= 8, iq += 16, dst += 24) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)iq);
+		__m256i w = _mm256_or_si256(_mm256_and_si256(x, lo), _mm256_and_si256(_mm256_srli_epi32(x, 4), hi));
+		// 12 bytes per 128 bit lane, then close the gap between the lanes
+		w = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(w, shuf), join);
+		_mm256_storeu_si256((__m256i *)dst, w);
+	}
+	pack_ssse3(dst, iq, n);
+}
+
+__attribute__((target("avx2")))
+static void unpack_avx2(int16_t *iq, const uint8_t *src, size_t n) {
+	const __m256i split = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i shuf = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+		0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+	const __m256i ilane = _mm256_set1_epi32(0x0000ffff);
+	for (; n >= 11; n -= 8, iq += 16, src += 24) {
+		// bytes 0-11 to the low lane, 12-23 to the high lane
+		__m256i x = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)src), split);
+		x = _mm256_shuffle_epi8(x, shuf);
+		__m256i i = _mm256_srai_epi16(_mm256_slli_epi16(x, 4), 4);
+		__m256i q = _mm256_srai_epi16(x, 4);
+		_mm256_storeu_si256((__m256i *)iq, _mm256_or_si256(_mm256_and_si256(ilane, i), _mm256_andnot_si256(ilane, q)));
+	}
+	unpack_ssse3(iq, src, n);
+}
+
+static int has_avx2(void) {
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+#ifdef PACK12_NEON
+
+static void pack_neon(uint8_t *dst, const int16_t *iq, size_t n) {
+	static const uint8_t idx[16] = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 255, 255, 255, 255};
+	const uint8x16_t shuf = vld1q_u8(idx);
+	const uint32x4_t lo = vdupq_n_u32(0x00000fff), hi = vdupq_n_u32(0x00fff000);
+	for (; n >= 6; n -= 4, iq += 8, dst += 12) {
+		uint32x4_t x = vreinterpretq_u32_s16(vld1q_s16(iq));
+		uint32x4_t w = vorrq_u32(vandq_u32(x, lo), vandq_u32(vshrq_n_u32(x, 4), hi));
+		vst1q_u8(dst, vqtbl1q_u8(vreinterpretq_u8_u32(w), shuf));
+	}
+	pack_c(dst, iq, n);
+}
+
+static void unpack_neon(int16_t *iq, const uint8_t *src, size_t n) {
+	static const uint8_t idx[16] = {0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11};
+	const uint8x16_t shuf = vld1q_u8(idx);
+	const uint32x4_t ilane = vdupq_n_u32(0x0000ffff);
+	for (; n >= 6; n -= 4, iq += 8, src += 12) {
+		int16x8_t x = vreinterpretq_s16_u8(vqtbl1q_u8(vld1q_u8(src), shuf));
+		int16x8_t i = vshrq_n_s16(vshlq_n_s16(x, 4), 4);
+		int16x8_t q = vshrq_n_s16(x, 4);
+		vst1q_s16(iq, vbslq_s16(vreinterpretq_u16_u32(ilane), i, q));
+	}
+	unpack_c(iq, src, n);
+}
+
+#endif
+
+/* best first */
+static const struct pack12_impl impls[] = {
+#ifdef PACK12_X86
+	{ "avx2",  has_avx2,  pack_avx2,  unpack_avx2 },
+	{ "ssse3", has_ssse3, pack_ssse3, unpack_ssse3 },
+#endif
+#ifdef PACK12_NEON
+	{ "neon",  always,    pack_neon,  unpack_neon },
+#endif
+	{ "c",     always,    pack_c,     unpack_c },
+};
+
+static const struct pack12_impl *best = &impls[sizeof(impls) / sizeof(impls[0]) - 1];
+
+__attribute__((constructor))
+static void pack12_init(void) {
+	for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		if (impls[i].usable()) {
+			best = &impls[i];
+			return;
+		}
+	}
+}
+
+void pack12(uint8_t *dst, const int16_t *iq, size_t n) {
+	best->pack(dst, iq, n);
+}
+
+void unpack12(int16_t *iq, const uint8_t *src, size_t n) {
+	best->unpack(iq, src, n);
+}
+
+const char *pack12_name(void) {
+	return best->name;
+}
+
+const struct pack12_impl *pack12_impls(size_t *n) {
+	*n = sizeof(impls) / sizeof(impls[0]);
+	return impls;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACK12_H
+#define PACK12_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * packed12: SC16 Q11 only uses 12 bits per component, so a sample (I, Q)
+ * is stored in 3 bytes as the little endian 24 bit word
+ *     (I & 0xfff) | (Q & 0xfff) << 12
+ * n counts samples (I/Q pairs) throughout.
+ */
+
+#define PACK12_BYTES    3
+
+struct pack12_impl {
+	const char *name;
+	int  (*usable)(void);
+	void (*pack)(uint8_t *dst, const int16_t *iq, size_t n);
+	void (*unpack)(int16_t *iq, const uint8_t *src, size_t n);
+};
+
+/* fastest kernel the CPU supports, picked at startup */
+void pack12(uint8_t *dst, const int16_t *iq, size_t n);
+void unpack12(int16_t *iq, const uint8_t *src, size_t n);
+const char *pack12_name(void);
+
+/* all kernels built in, for benchmarks */
+const struct pack12_impl *pack12_impls(size_t *n);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Packing sink: takes SC16 Q11 and stores packed12 (see pack12.h) in the
+ * inner sink, packing straight into the inner sink's memory. Sizes and
+ * positions of this sink count SC16 bytes, the inner one's file bytes.
+ * Meant to sit behind the pipeline, so packing runs on the writer thread.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "storage.h"
+#include "pack12.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define STAGE_SIZE  (1 << 20)   // get()/put() staging, SC16 bytes
+
+struct packed {
+	struct sink *inner;
+	int16_t *stage;
+};
+
+/* n samples of SC16 into the inner sink */
+static int pack_into(struct sink *s, const int16_t *iq, size_t n) {
+	struct packed *pk = s->priv;
+	struct sink *in = pk->inner;
+	int res;
+
+	sink_mark(in, sink_ts(s));
+	while (n) {
+		size_t len = n * PACK12_BYTES, k;
+		void *dst;
+		if ((res = sink_get(in, &dst, &len)))
+			return res;
+		if (!len)
+			return -1;      // full
+		if ((k = len / PACK12_BYTES)) {
+			pack12(dst, iq, k);
+			res = sink_put(in, k * PACK12_BYTES);
+		}
+		else {
+			// a sample straddles a ring wrap or buffer end
+			uint8_t tmp[PACK12_BYTES];
+			pack12(tmp, iq, k = 1);
+			res = sink_copy(in, tmp, sizeof(tmp));
+		}
+		if (res)
+			return res;
+		iq += 2 * k;
+		n -= k;
+		s->written += k * 4;
+	}
+	s->stall_us = in->stall_us;
+	return 0;
+}
+
+static int packed_get(struct sink *s, void **dst, size_t *len) {
+	struct packed *pk = s->priv;
+	*len = MIN(*len, MIN((size_t)STAGE_SIZE, s->size - s->written));
+	*dst = pk->stage;
+	return 0;
+}
+
+static int packed_put(struct sink *s, size_t len) {
+	struct packed *pk = s->priv;
+	return pack_into(s, pk->stage, len / 4);
+}
+
+static int packed_write(struct sink *s, void *data, size_t len, void *tag) {
+	int res = pack_into(s, data, MIN(len, s->size - s->written) / 4);
+	s->release(s->release_ctx, tag);
+	return res;
+}
+
+static int packed_flush(struct sink *s) {
+	struct packed *pk = s->priv;
+	return sink_flush(pk->inner);
+}
+
+static void packed_close(struct sink *s) {
+	struct packed *pk = s->priv;
+	sink_close(pk->inner);
+	free(pk->stage);
+	free(pk);
+}
+
+static const struct sink_ops packed_ops = {
+	.name  = "packed12",
+	.get   = packed_get,
+	.put   = packed_put,
+	.write = packed_write,
+	.flush = packed_flush,
+	.close = packed_close,
+};
+
+/* inner: an open sink, closed along with s */
+int sink_open_packed(struct sink *s, struct sink *inner) {
+	struct packed *pk = calloc(1, sizeof(struct packed));
+	if (!pk || !(pk->stage = malloc(STAGE_SIZE))) {
+		perror("packed12");
+		free(pk);
+		sink_close(inner);
+		return -1;
+	}
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &packed_ops;
+	s->size = inner->size / PACK12_BYTES * 4;
+	s->ss = 4;
+	s->priv = pk;
+	pk->inner = inner;
+	inner->ss = PACK12_BYTES;
+	return 0;
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Channel c's output at input sample n is the input mixed down by
+ * c / nch turns per sample and lowpassed by the prototype h:
+ *
+ *   y_c[n] = sum_i h[i] x[n - i] exp(-j 2 pi c (n - i) / nch)
+ *
+ * With the L = nch * PFB_TAPS input samples ending at n folded into
+ * w[p] = sum_t h[p + t nch] x[n - L + 1 + p + t nch] (h is symmetric),
+ * this is FFT(w)[c] * exp(-j 2 pi c (n + 1) / nch).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pfb.h"
+
+#define PFB_ATTEN   80          // prototype stopband, dB
+
+struct pfb_scratch {
+	float *re, *im;
+	float *wr, *wi;
+	float *yr, *yi;         // selected channels' outputs, a row each
+	size_t stride;
+	struct fft fft;
+};
+
+static int pfb_select(struct pfb *p, const char *list) {
+	int n = p->nch;
+	char seen[PFB_MAX_CH] = {0};
+
+	if (!list) {
+		for (int c = -n / 2; c < n / 2; c++)
+			p->sel[p->nsel++] = c;
+		return 0;
+	}
+	for (const char *q = list; ; q++) {
+		char *end;
+		long a = strtol(q, &end, 10), b = a;
+		if (end == q)
+			return -1;
+		if (end[0] == '.' && end[1] == '.') {
+			q = end + 2;
+			b = strtol(q, &end, 10);
+			if (end == q)
+				return -1;
+		}
+		for (long c = a; c <= b; c++) {
+			if ((c < -n / 2) || (c >= n / 2)) {
+				fprintf(stderr, "PFB: channel %ld is not in -%d..%d\n", c, n / 2, n / 2 - 1);
+				return -1;
+			}
+			if (!seen[c + n / 2]++)
+				p->sel[p->nsel++] = c;
+		}
+		if (!*end)
+			return p->nsel ? 0 : -1;
+		if (*end != ',')
+			return -1;
+		q = end;
+	}
+}
+
+int pfb_parse(struct pfb *p, const char *spec, int oversample, double rate, size_t ss) {
+	char *end;
+	long n = strtol(spec, &end, 10);
+
+	memset(p, 0, sizeof(struct pfb));
+	p->rate = rate;
+	p->ss = ss;
+	if ((n < 8) || (n > PFB_MAX_CH) || (n & (n - 1))) {
+		fprintf(stderr, "PFB: the number of channels must be a power of 2 from 8 to %d\n", PFB_MAX_CH);
+		return -1;
+	}
+	p->nch = n;
+	p->decim = oversample ? n / 2 : n;
+	p->taps = n * PFB_TAPS;
+	p->hist = (p->taps - 1 + p->decim - 1) / p->decim * p->decim;
+	p->sel = malloc(n * sizeof(int));
+	p->g = malloc(p->taps * sizeof(float));
+	p->rot_re = malloc(n * sizeof(float));
+	p->rot_im = malloc(n * sizeof(float));
+	if (!p->sel || !p->g || !p->rot_re || !p->rot_im) {
+		perror("PFB");
+		pfb_free(p);
+		return -1;
+	}
+	if (((*end != ':') && *end) || pfb_select(p, (*end == ':') ? end + 1 : NULL)) {
+		fprintf(stderr, "PFB: bad spec %s\n", spec);
+		pfb_free(p);
+		return -1;
+	}
+
+	// cutoff at half the channel spacing, transition as narrow as the length allows
+	double fc = 0.5 / n, tw = (PFB_ATTEN - 7.95) / (14.36 * (p->taps - 1));
+	fir_kaiser_lowpass(p->g, p->taps, fc - tw / 2, fc + tw / 2, PFB_ATTEN);
+	for (int q = 0; q < n; q++) {
+		p->rot_re[q] = cos(2 * M_PI * q / n);
+		p->rot_im[q] = -sin(2 * M_PI * q / n);
+	}
+	return 0;
+}
+
+void pfb_free(struct pfb *p) {
+	free(p->sel);
+	free(p->g);
+	free(p->rot_re);
+	free(p->rot_im);
+	memset(p, 0, sizeof(struct pfb));
+}
+
+void *pfb_scratch_new(const struct pfb *p, size_t len) {
+	struct pfb_scratch *sc = calloc(1, sizeof(struct pfb_scratch));
+	size_t n = p->hist + len;
+
+	if (!sc)
+		return NULL;
+	sc->re = malloc(n * sizeof(float));
+	sc->im = malloc(n * sizeof(float));
+	sc->wr = malloc(p->nch * sizeof(float));
+	sc->wi = malloc(p->nch * sizeof(float));
+	sc->stride = (len + p->decim - 1) / p->decim;
+	sc->yr = malloc(p->nsel * sc->stride * sizeof(float));
+	sc->yi = malloc(p->nsel * sc->stride * sizeof(float));
+	if (!sc->re || !sc->im || !sc->wr || !sc->wi || !sc->yr || !sc->yi || fft_init(&sc->fft, p->nch)) {
+		pfb_scratch_free(sc);
+		return NULL;
+	}
+	return sc;
+}
+
+void pfb_scratch_free(void *scratch) {
+	struct pfb_scratch *sc = scratch;
+	free(sc->re);
+	free(sc->im);
+	free(sc->wr);
+	free(sc->wi);
+	free(sc->yr);
+	free(sc->yi);
+	fft_free(&sc->fft);
+	free(sc);
+}
+
+size_t pfb_run(const struct pfb *p, void *scratch, const void *in, size_t len, uint64_t start,
+	int16_t *out, size_t stride)
+{
+	struct pfb_scratch *sc = scratch;
+	size_t cnt = (len + p->decim - 1) / p->decim;
+	int mask = p->nch - 1;
+
+	iq_to_float(sc->re, sc->im, in, p->hist + len, p->ss);
+	for (size_t j = 0; j < cnt; j++) {
+		size_t ofs = p->hist + j * p->decim - (p->taps - 1);
+		int t = (start + j * p->decim + 1) & mask;
+		fir_fold(sc->wr, sc->wi, sc->re + ofs, sc->im + ofs, p->g, p->nch, PFB_TAPS);
+		fft_run(&sc->fft, sc->wr, sc->wi, 0);
+		for (int i = 0; i < p->nsel; i++) {
+			int k = p->sel[i] & mask, q = (k * t) & mask;
+			sc->yr[i * sc->stride + j] = sc->wr[k] * p->rot_re[q] - sc->wi[k] * p->rot_im[q];
+			sc->yi[i * sc->stride + j] = sc->wr[k] * p->rot_im[q] + sc->wi[k] * p->rot_re[q];
+		}
+	}
+	for (int i = 0; i < p->nsel; i++)
+		float_to_sc16(out + 2 * i * stride, sc->yr + i * sc->stride, sc->yi + i * sc->stride, cnt);
+	return cnt;
+}
+
+void pfb_describe(const struct pfb *p, FILE *fl, const char *pattern) {
+	fprintf(fl, "# SC16 per channel at out_rate, input full scale = 32767, baseband\n");
+	fprintf(fl, "# output sample m is input sample m * decimation - delay\n");
+	fprintf(fl, "in_rate %.0f\n", p->rate);
+	fprintf(fl, "channels %d\n", p->nch);
+	fprintf(fl, "spacing %.0f\n", p->rate / p->nch);
+	fprintf(fl, "out_rate %.0f\n", p->rate / p->decim);
+	fprintf(fl, "decimation %d\n", p->decim);
+	fprintf(fl, "taps %d kaiser stopband_db %d\n", p->taps, PFB_ATTEN);
+	fprintf(fl, "delay %.1f\n", (p->taps - 1) / 2.0);
+	for (int i = 0; i < p->nsel; i++) {
+		fprintf(fl, "channel %d %.0f ", p->sel[i], p->sel[i] * p->rate / p->nch);
+		fprintf(fl, pattern, p->sel[i]);
+		fputc('\n', fl);
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PFB_H
+#define PFB_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsp.h"
+
+/*
+ * Polyphase filterbank channelizer: splits the band into nch channels
+ * spaced rate / nch apart, channel c centered at c * rate / nch for
+ * c = -nch/2 .. nch/2-1. One output per decim input samples, decim is
+ * nch (critically sampled) or nch / 2 (2x oversampled, channel edges
+ * don't alias). The prototype lowpass has PFB_TAPS taps per branch.
+ *
+ * Per output the last nch * PFB_TAPS samples are windowed and folded
+ * into nch points, and one FFT gives every channel at once, only the
+ * selected ones are kept. Outputs are baseband SC16 at full scale 32767
+ * like the DDC's. Blocks work like ddc_run()'s.
+ */
+
+#define PFB_TAPS        12
+#define PFB_MAX_CH      4096
+
+struct pfb {
+	double rate;
+	size_t ss;
+	int nch, decim, taps;
+	float *g;               // prototype, reversed
+	float *rot_re, *rot_im; // exp(-j * 2 pi * q / nch)
+	int nsel;
+	int *sel;               // selected channels, -nch/2 .. nch/2-1
+	size_t hist;            // multiple of decim
+};
+
+/* <channels>[:<list>], list like -3,0,5..9 (all by default) */
+int  pfb_parse(struct pfb *p, const char *spec, int oversample, double rate, size_t ss);
+void pfb_free(struct pfb *p);
+
+void *pfb_scratch_new(const struct pfb *p, size_t len);
+void pfb_scratch_free(void *scratch);
+
+/* in: hist + len samples, start a multiple of decim; selected channel i's
+ * outputs go to out + i * stride samples, returns the count per channel */
+size_t pfb_run(const struct pfb *p, void *scratch, const void *in, size_t len, uint64_t start,
+	int16_t *out, size_t stride);
+
+/* key value lines for a metadata sidecar, pattern: printf pattern of the channel files */
+void pfb_describe(const struct pfb *p, FILE *fl, const char *pattern);
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "pipeline.h"
+
+#define POLL_NS     200000     // idle wait of both threads
+
+int spsc_init(struct spsc *q, size_t n) {
+	size_t sz = 1;
+	while (sz < n)
+		sz <<= 1;
+	q->slot = calloc(sz, sizeof(void *));
+	q->mask = sz - 1;
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+	return q->slot ? 0 : -1;
+}
+
+void spsc_free(struct spsc *q) {
+	free(q->slot);
+	q->slot = NULL;
+}
+
+static void idle(void) {
+	struct timespec ts = {.tv_nsec = POLL_NS};
+	nanosleep(&ts, NULL);
+}
+
+/* called by the sink, on the writer thread, once a buffer is persisted */
+static void release(void *ctx, void *tag) {
+	struct pipeline *p = ctx;
+	struct buf *b = tag;
+	atomic_fetch_add(&p->written, b->len);
+	spsc_push(&p->free, b);
+}
+
+static void *writer_thread(void *arg) {
+	struct pipeline *p = arg;
+
+	for (;;) {
+		struct buf *b = spsc_pop(&p->full);
+		if (!b) {
+			if (atomic_load(&p->stop) && !pipeline_fill(p))
+				break;
+			idle();
+			continue;
+		}
+		if (b->gap) {
+			if (sink_zero(p->sink, b->gap)) {
+				atomic_store(&p->failed, 1);
+				break;
+			}
+			atomic_fetch_add(&p->written, b->gap);
+		}
+		p->pos += b->gap;
+		if (p->tap)
+			p->tap(p->tap_ctx, b, p->pos);
+		p->pos += b->len;
+		sink_mark(p->sink, b->ts);
+		p->handed++;
+		if (sink_write(p->sink, b->data, b->len, b)) {
+			atomic_store(&p->failed, 1);
+			break;
+		}
+	}
+	sink_flush(p->sink);
+	return NULL;
+}
+
+static void pipeline_free(struct pipeline *p) {
+	spsc_free(&p->free);
+	spsc_free(&p->full);
+	free(p->bufs);
+	p->bufs = NULL;
+	buf_free(p->mem, p->mem_size);
+	p->mem = NULL;
+}
+
+/* ext: use these nbufs buffers (e.g. libbladeRF's stream buffers) instead of allocating */
+int pipeline_start(struct pipeline *p, struct sink *s, size_t nbufs, size_t buf_size, void **ext) {
+	memset(p, 0, sizeof(struct pipeline));
+	p->sink = s;
+	p->nbufs = nbufs;
+	s->release = release;
+	s->release_ctx = p;
+
+	if (!ext) {
+		// one contiguous, prefaulted and (if allowed) locked block for all buffers
+		buf_size = (buf_size + 4095) & ~(size_t)4095;
+		p->mem_size = nbufs * buf_size;
+		if (!(p->mem = buf_alloc(&p->mem_size, "buffer pool")))
+			return -1;
+		if (mlock(p->mem, p->mem_size) != 0)
+			perror("mlock (buffer pool)");
+	}
+
+	p->bufs = calloc(nbufs, sizeof(struct buf));
+	if (!p->bufs || spsc_init(&p->free, nbufs) || spsc_init(&p->full, nbufs)) {
+		perror("pipeline");
+		goto fail;
+	}
+	for (size_t i = 0; i < nbufs; i++) {
+		p->bufs[i].data = ext ? ext[i] : (uint8_t *)p->mem + i * buf_size;
+		p->bufs[i].cap  = buf_size;
+		spsc_push(&p->free, &p->bufs[i]);
+	}
+
+	if (pthread_create(&p->writer, NULL, writer_thread, p)) {
+		perror("pthread_create");
+		goto fail;
+	}
+	return 0;
+fail:
+	pipeline_free(p);
+	return -1;
+}
+
+/* drains all queued buffers, then joins the writer */
+void pipeline_stop(struct pipeline *p) {
+	atomic_store(&p->stop, 1);
+	pthread_join(p->writer, NULL);
+	pipeline_free(p);
+}
+
+struct buf *pipeline_find(struct pipeline *p, void *data) {
+	for (size_t i = 0; i < p->nbufs; i++) {
+		if (p->bufs[i].data == data)
+			return &p->bufs[i];
+	}
+	return NULL;
+}
+
+/* waits for a free buffer, NULL if the writer has failed */
+struct buf *pipeline_get(struct pipeline *p) {
+	struct buf *b = spsc_pop(&p->free);
+	if (b)
+		return b;
+	atomic_fetch_add(&p->starved, 1);
+	while (!(b = spsc_pop(&p->free))) {
+		if (atomic_load(&p->failed))
+			return NULL;
+		idle();
+	}
+	return b;
+}
+
+void pipeline_put(struct pipeline *p, struct buf *b) {
+	// can't fail: the queue holds all buffers of the pool
+	spsc_push(&p->full, b);
+	size_t fill = pipeline_fill(p), max = atomic_load(&p->fill_max);
+	while (fill > max && !atomic_compare_exchange_weak(&p->fill_max, &max, fill));
+}
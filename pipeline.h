@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "storage.h"
+
+/*
+ * Single producer / single consumer ring of pointers. head is only written
+ * by the producer, tail only by the consumer, so neither side needs a lock.
+ */
+struct spsc {
+	void **slot;
+	size_t mask;
+	_Atomic size_t head;
+	_Atomic size_t tail;
+};
+
+int  spsc_init(struct spsc *q, size_t n);
+void spsc_free(struct spsc *q);
+
+static inline size_t spsc_fill(struct spsc *q) {
+	return atomic_load_explicit(&q->head, memory_order_acquire) -
+		atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+static inline int spsc_push(struct spsc *q, void *p) {
+	size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&q->tail, memory_order_acquire) > q->mask)
+		return -1;
+	q->slot[head & q->mask] = p;
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+	return 0;
+}
+
+static inline void *spsc_pop(struct spsc *q) {
+	size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	if (tail == atomic_load_explicit(&q->head, memory_order_acquire))
+		return NULL;
+	void *p = q->slot[tail & q->mask];
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+	return p;
+}
+
+struct buf {
+	void *data;
+	size_t cap;
+	size_t len;        // valid bytes
+	size_t gap;        // zero bytes to insert in front (overrun fill)
+	uint64_t ts;       // device timestamp of the first sample in data
+};
+
+/*
+ * Preallocated buffer pool between the RX thread and the writer thread.
+ * Buffers circulate free -> RX -> full -> writer -> free.
+ */
+struct pipeline {
+	struct buf *bufs;
+	size_t nbufs;
+	void *mem;
+	size_t mem_size;
+	struct spsc free, full;
+	struct sink *sink;
+	pthread_t writer;
+	_Atomic int stop;          // no more buffers will be queued
+	_Atomic int failed;        // writer gave up (error or sink full)
+	_Atomic size_t written;    // bytes stored by the writer
+	_Atomic size_t fill_max;   // max. queue fill since last pipeline_fill_max()
+	_Atomic size_t starved;    // times the RX thread found no free buffer
+	size_t handed;             // buffers passed to sink_write(), writer thread only
+
+	/* optional hook on the writer thread, pos: stream offset of b->data */
+	void (*tap)(void *ctx, struct buf *b, uint64_t pos);
+	void *tap_ctx;
+	uint64_t pos;
+};
+
+int  pipeline_start(struct pipeline *p, struct sink *s, size_t nbufs, size_t buf_size, void **ext);
+void pipeline_stop(struct pipeline *p);
+struct buf *pipeline_find(struct pipeline *p, void *data);
+
+/* RX side */
+struct buf *pipeline_get(struct pipeline *p);
+void pipeline_put(struct pipeline *p, struct buf *b);
+
+static inline size_t pipeline_fill(struct pipeline *p) {
+	return spsc_fill(&p->full);
+}
+
+static inline size_t pipeline_fill_max(struct pipeline *p) {
+	return atomic_exchange(&p->fill_max, pipeline_fill(p));
+}
+
+#endif
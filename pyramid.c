@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "pyramid.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+/* vector types like lpc.c, so the kernel vectorizes at -O2 */
+typedef int v8si __attribute__((vector_size(32)));
+typedef unsigned int v8su __attribute__((vector_size(32)));
+typedef float v8sf __attribute__((vector_size(32)));
+
+#if defined(__x86_64__)
+#define MULTIVERSION    __attribute__((target_clones("avx2", "default")))
+#else
+#define MULTIVERSION
+#endif
+
+#define PYR_CHUNK   1024        // samples summed in float before going to double
+
+static void pyr_reset(struct pyr_acc *a) {
+	a->min = INFINITY;
+	a->max = 0;
+	a->sum = 0;
+	a->n = 0;
+}
+
+/*
+ * Adds n samples to a. A 32 bit lane holds one SC16 sample or two SC8
+ * ones, I in the low half; powers fit unsigned 32 bits.
+ */
+MULTIVERSION
+static void pyr_block(struct pyr_acc *a, const void *iq, size_t n, size_t ss) {
+	const uint8_t *p = iq;
+	size_t per = (ss == 2) ? 16 : 8, i = 0;
+	v8su lo = {0}, hi = {0};
+	int any = 0;
+
+	lo = ~lo;
+	while (i + per <= n) {
+		v8sf acc = {0};
+		for (size_t k = 0; (k < PYR_CHUNK) && (i + per <= n); k += per, i += per) {
+			v8si w, x, y;
+			v8su q, m;
+			memcpy(&w, p + i * ss, sizeof(w));
+			if (ss == 2) {
+				x = (w << 24) >> 24;
+				y = (w << 16) >> 24;
+				q = (v8su)(x * x) + (v8su)(y * y);
+				acc += __builtin_convertvector(q, v8sf);
+				m = (v8su)(q < lo);
+				lo = (q & m) | (lo & ~m);
+				m = (v8su)(q > hi);
+				hi = (q & m) | (hi & ~m);
+				x = (w << 8) >> 24;
+				y = w >> 24;
+			}
+			else {
+				x = (w << 16) >> 16;
+				y = w >> 16;
+			}
+			q = (v8su)(x * x) + (v8su)(y * y);
+			acc += __builtin_convertvector(q, v8sf);
+			m = (v8su)(q < lo);
+			lo = (q & m) | (lo & ~m);
+			m = (v8su)(q > hi);
+			hi = (q & m) | (hi & ~m);
+		}
+		a->sum += ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+		any = 1;
+	}
+	for (int l = 0; any && (l < 8); l++) {
+		a->min = fminf(a->min, lo[l]);
+		a->max = fmaxf(a->max, hi[l]);
+	}
+	for (; i < n; i++) {
+		int x, y;
+		if (ss == 2) {
+			x = ((const int8_t *)p)[2 * i];
+			y = ((const int8_t *)p)[2 * i + 1];
+		}
+		else {
+			x = ((const int16_t *)p)[2 * i];
+			y = ((const int16_t *)p)[2 * i + 1];
+		}
+		float q = (float)((uint32_t)(x * x) + (uint32_t)(y * y));
+		a->sum += q;
+		a->min = fminf(a->min, q);
+		a->max = fmaxf(a->max, q);
+	}
+	a->n += n;
+}
+
+static uint16_t pyr_mag(double power) {
+	double v = sqrt(power) * PYR_SCALE + 0.5;
+	return (v >= 65535) ? 65535 : (uint16_t)v;
+}
+
+static int pyr_header(struct pyramid *p) {
+	struct pyr_header *h = &p->hdr;
+	h->samples = MIN(p->next, h->capacity);
+	if (pwrite(fileno(p->fl), h, sizeof(*h), 0) != sizeof(*h)) {
+		perror("pyramid");
+		return -1;
+	}
+	return 0;
+}
+
+static int pyr_flush(struct pyramid *p, int l) {
+	struct pyr_level *v = &p->lv[l];
+	size_t len = v->fill * sizeof(struct pyr_entry);
+
+	if (len && (pwrite(fileno(p->fl), v->buf, len, p->hdr.offset[l] + v->first * sizeof(struct pyr_entry)) != (ssize_t)len)) {
+		perror("pyramid");
+		return -1;
+	}
+	v->first += v->fill;
+	v->fill = 0;
+	return (l == 0) ? pyr_header(p) : 0;
+}
+
+/* entries past the capacity have no room and are dropped */
+static int pyr_emit(struct pyramid *p, int l) {
+	struct pyr_level *v = &p->lv[l];
+	struct pyr_acc *a = &v->acc;
+
+	if (v->idx < pyramid_entries(&p->hdr, l, p->hdr.capacity)) {
+		struct pyr_entry *e = &v->buf[v->fill++];
+		if (a->n) {
+			e->min = pyr_mag(a->min);
+			e->max = pyr_mag(a->max);
+			e->rms = pyr_mag(a->sum / a->n);
+		}
+		else
+			memset(e, 0, sizeof(*e));
+		if ((v->fill == PYR_BUF) && pyr_flush(p, l))
+			return -1;
+	}
+	v->idx++;
+	if (l + 1 < (int)p->hdr.levels) {
+		struct pyr_level *u = &p->lv[l + 1];
+		u->acc.min = fminf(u->acc.min, a->min);
+		u->acc.max = fmaxf(u->acc.max, a->max);
+		u->acc.sum += a->sum;
+		u->acc.n += a->n;
+		if ((++u->parts == 2) && pyr_emit(p, l + 1))
+			return -1;
+	}
+	pyr_reset(a);
+	v->parts = 0;
+	return 0;
+}
+
+int pyramid_open(struct pyramid *p, FILE *fl, double rate, size_t ss, uint32_t base, uint64_t capacity) {
+	struct pyr_header *h = &p->hdr;
+	uint64_t ofs = sizeof(struct pyr_header);
+
+	memset(p, 0, sizeof(struct pyramid));
+	p->fl = fl;
+	if ((base < 16) || (base > (1 << 24)) || (base & (base - 1))) {
+		fputs("pyramid: base must be a power of 2 from 16 to 2^24 samples\n", stderr);
+		return -1;
+	}
+	*h = (struct pyr_header){
+		.magic = PYR_MAGIC, .version = 1, .ss = ss, .base = base, .rate = rate, .capacity = capacity,
+	};
+	for (uint64_t span = base; ; span *= 2) {
+		uint64_t entries = (capacity + span - 1) / span;
+		h->offset[h->levels++] = ofs;
+		ofs += entries * sizeof(struct pyr_entry);
+		if ((entries <= 1) || (h->levels == PYR_MAX_LEVELS))
+			break;
+	}
+	if (!(p->lv = calloc(h->levels, sizeof(struct pyr_level)))) {
+		perror("pyramid");
+		return -1;
+	}
+	for (uint32_t l = 0; l < h->levels; l++)
+		pyr_reset(&p->lv[l].acc);
+	return pyr_header(p);
+}
+
+int pyramid_run(struct pyramid *p, const void *iq, size_t n, uint64_t pos) {
+	struct pyr_level *v = &p->lv[0];
+	const uint8_t *q = iq;
+	size_t base = p->hdr.base;
+
+	if (p->failed)
+		return -1;
+	// samples lost in front: skipped over, the entries they fall in get what's left
+	while (pos > p->next) {
+		size_t k = MIN(pos - p->next, base - v->parts);
+		v->parts += k;
+		p->next += k;
+		if ((v->parts == base) && pyr_emit(p, 0))
+			goto fail;
+	}
+	while (n) {
+		size_t k = MIN(n, base - v->parts);
+		pyr_block(&v->acc, q, k, p->hdr.ss);
+		v->parts += k;
+		p->next += k;
+		q += k * p->hdr.ss;
+		n -= k;
+		if ((v->parts == base) && pyr_emit(p, 0))
+			goto fail;
+	}
+	return 0;
+fail:
+	p->failed = 1;
+	return -1;
+}
+
+int pyramid_close(struct pyramid *p) {
+	int res = p->failed ? -1 : 0;
+
+	if (!p->fl)
+		return 0;
+	if (p->lv) {
+		// the partial last entry of every level, bottom up so each gets its children
+		for (uint32_t l = 0; !res && (l < p->hdr.levels); l++) {
+			if (p->lv[l].parts && pyr_emit(p, l))
+				res = -1;
+		}
+		for (uint32_t l = 0; !res && (l < p->hdr.levels); l++)
+			res = pyr_flush(p, l);
+	}
+	if (!res)
+		res = pyr_header(p);
+	if (p->fl)
+		fclose(p->fl);
+	free(p->lv);
+	memset(p, 0, sizeof(struct pyramid));
+	return res;
+}
+
+uint64_t pyramid_entries(const struct pyr_header *h, int l, uint64_t count) {
+	return ((count + ((uint64_t)h->base << l) - 1) >> l) / h->base;
+}
+
+int pyramid_level(const struct pyr_header *h, uint64_t count, uint64_t n) {
+	int l = 0;
+	while ((l + 1 < (int)h->levels) && (pyramid_entries(h, l + 1, count) >= n))
+		l++;
+	return l;
+}
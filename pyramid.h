@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Magnitude pyramid sidecar: min, max and RMS of |x| over blocks of
+ * base samples (level 0), 2 * base (level 1) and so on up to one entry
+ * for the whole capture, so a viewer draws any zoom level of it from a
+ * few kB instead of scanning the samples.
+ *
+ *     pyr_header | level 0 entries | level 1 entries | ...
+ *
+ * Level l starts at offset[l] and holds room for capacity samples, entry
+ * i covers samples [i, i + 1) * (base << l). Entries are written as their
+ * blocks complete, header.samples tells how far they are valid. Values
+ * are |x| in LSB times PYR_SCALE, saturating. Samples that never made it
+ * to the worker are left out, an entry without any is all zeros. All
+ * fields little endian.
+ */
+
+#define PYR_MAGIC       "IQP1"
+#define PYR_SCALE       16
+#define PYR_MAX_LEVELS  48
+#define PYR_BUF         1024    // entries buffered per level
+
+struct pyr_header {
+	char magic[4];
+	uint16_t version;      // 1
+	uint16_t ss;
+	uint32_t base;         // samples per level 0 entry, power of 2
+	uint32_t levels;
+	double rate;
+	uint64_t samples;      // valid
+	uint64_t capacity;
+	uint64_t offset[PYR_MAX_LEVELS];
+};
+
+struct pyr_entry {
+	uint16_t min, max, rms;
+};
+
+/* an entry being summed up, powers |x|^2 */
+struct pyr_acc {
+	float min, max;
+	double sum;
+	uint64_t n;
+};
+
+struct pyr_level {
+	struct pyr_acc acc;
+	uint64_t parts;             // children (samples on level 0) in acc
+	uint64_t idx;               // next entry
+	uint64_t first;             // entry of buf[0]
+	int fill;
+	struct pyr_entry buf[PYR_BUF];
+};
+
+struct pyramid {
+	struct pyr_header hdr;
+	FILE *fl;
+	uint64_t next;              // stream sample expected next
+	int failed;
+	struct pyr_level *lv;
+};
+
+/* base: samples per level 0 entry, capacity: samples the file has room for */
+int  pyramid_open(struct pyramid *p, FILE *fl, double rate, size_t ss, uint32_t base, uint64_t capacity);
+/* n samples at stream sample pos */
+int  pyramid_run(struct pyramid *p, const void *iq, size_t n, uint64_t pos);
+/* writes the partial entries and the header, closes the file */
+int  pyramid_close(struct pyramid *p);
+
+/* entries of level l covering count samples */
+uint64_t pyramid_entries(const struct pyr_header *h, int l, uint64_t count);
+/* coarsest level with at least n entries over count samples, else 0 */
+int  pyramid_level(const struct pyr_header *h, uint64_t count, uint64_t n);
+
+#endif
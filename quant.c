@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Near-lossless codec for SC16 blocks: drops the low bits that are buried
+ * in the noise, then codes what is left with the lossless LPC codec.
+ *
+ * The noise floor of a block is the power of its quietest frames (the
+ * QUIET_PCT percentile of FRAME sample frames, so bursts don't count).
+ * All samples are rounded to a step of 2^shift, the largest step whose
+ * quantization noise (step^2 / 12) stays below level percent of the noise
+ * floor's RMS. The rounded samples keep their correlation, so the LPC
+ * predictor and Rice coder of lpc.c do with them what they do with raw
+ * samples, only with shift fewer bits per residual.
+ *
+ * Block: shift:8  then the rounded samples as an LPC block. The decoder
+ * returns value << shift.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "iqz.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define FRAME       4096
+#define QUIET_PCT   10
+#define MAX_SHIFT   11
+
+struct quant {
+	double frac;            // max. quantization noise RMS / noise floor RMS
+	double *power;          // per frame
+	size_t nframes;
+	int16_t *iq;            // rounded block
+	void *lpc;
+};
+
+static void *quant_new(int level) {
+	struct quant *q = calloc(1, sizeof(struct quant));
+	if (!q)
+		return NULL;
+	q->frac = ((level > 0) ? level : 0) / 100.0;
+	q->nframes = (IQZ_BLOCK / 4 + FRAME - 1) / FRAME;
+	q->power = malloc(q->nframes * sizeof(double));
+	q->iq = malloc(q->nframes * FRAME * 4);
+	q->lpc = codec_lpc.ctx_new(codec_lpc.level);
+	if (!q->power || !q->iq || !q->lpc) {
+		if (q->lpc)
+			codec_lpc.ctx_free(q->lpc);
+		free(q->power);
+		free(q->iq);
+		free(q);
+		return NULL;
+	}
+	return q;
+}
+
+static void quant_free(void *ctx) {
+	struct quant *q = ctx;
+	codec_lpc.ctx_free(q->lpc);
+	free(q->power);
+	free(q->iq);
+	free(q);
+}
+
+static size_t quant_bound(size_t len) {
+	// anything bigger is stored raw
+	return len + 1024;
+}
+
+static int cmp_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* step = 2^shift for a block of n samples */
+static int quant_shift(struct quant *q, const int16_t *iq, size_t n) {
+	size_t nfr = (n + FRAME - 1) / FRAME;
+	double step;
+	int shift = 0;
+
+	for (size_t f = 0; f < nfr; f++) {
+		size_t m = MIN((size_t)FRAME, n - f * FRAME);
+		const int16_t *p = iq + 2 * f * FRAME;
+		int64_t sum = 0;
+		for (size_t i = 0; i < 2 * m; i++)
+			sum += p[i] * p[i];
+		q->power[f] = (double)sum / (2 * m);
+	}
+	qsort(q->power, nfr, sizeof(double), cmp_double);
+	// step^2 / 12 <= (frac * sigma)^2
+	step = sqrt(12 * q->power[nfr * QUIET_PCT / 100]) * q->frac;
+	while ((shift < MAX_SHIFT) && ((2 << shift) <= step))
+		shift++;
+	return shift;
+}
+
+static size_t quant_compress(void *ctx, void *dst, size_t cap, const void *src, size_t len) {
+	struct quant *q = ctx;
+	const int16_t *iq = src;
+	uint8_t *out = dst;
+	size_t n = len / 4, clen;
+	int32_t round;
+	int shift;
+
+	if ((len % 4) || !n || (n > q->nframes * FRAME) || (cap < 2))
+		return 0;
+	shift = quant_shift(q, iq, n);
+	round = shift ? 1 << (shift - 1) : 0;
+	for (size_t i = 0; i < 2 * n; i++)
+		q->iq[i] = (iq[i] + round) >> shift;
+	out[0] = shift;
+	clen = codec_lpc.compress(q->lpc, out + 1, cap - 1, q->iq, len);
+	return clen ? clen + 1 : 0;
+}
+
+static int quant_decompress(void *dst, size_t len, const void *src, size_t n) {
+	const uint8_t *in = src;
+	int16_t *iq = dst;
+	int shift;
+
+	if ((len % 4) || (n < 1) || (in[0] > MAX_SHIFT))
+		return -1;
+	shift = in[0];
+	if (codec_lpc.decompress(dst, len, in + 1, n - 1))
+		return -1;
+	// scale back, clamp what rounding pushed past full scale
+	for (size_t i = 0; i < len / 2; i++) {
+		int32_t x = iq[i] * (1 << shift);
+		iq[i] = (x > 32767) ? 32767 : (x < -32768) ? -32768 : x;
+	}
+	return 0;
+}
+
+const struct codec codec_quant = {
+	.name       = "quant",
+	.id         = CODEC_QUANT,
+	.level      = 10,
+	.ctx_new    = quant_new,
+	.ctx_free   = quant_free,
+	.bound      = quant_bound,
+	.compress   = quant_compress,
+	.decompress = quant_decompress,
+	.ss         = 4,
+	.lossy      = 1,
+};
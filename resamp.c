@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "resamp.h"
+
+#define RESAMP_MAX_TAPS 4096    // per phase
+
+struct resamp_scratch {
+	float *re, *im;
+	float *yr, *yi;
+};
+
+/* l / m closest to x with l <= max_l, from the continued fraction */
+static int resamp_ratio(double x, long max_l, long *l, long *m) {
+	long h0 = 1, h1 = 0, k0 = 0, k1 = 1;
+	double f = x;
+
+	for (int i = 0; i < 64; i++) {
+		long a = floor(f), h = a * h0 + h1, k = a * k0 + k1;
+		if (h > max_l)
+			break;
+		h1 = h0, h0 = h;
+		k1 = k0, k0 = k;
+		if ((fabs((double)h / k - x) < 1e-9 * x) || (f - a < 1e-12))
+			break;
+		f = 1 / (f - a);
+	}
+	*l = h0;
+	*m = k0;
+	return (k0 > 0) && (fabs((double)h0 / k0 - x) < 1e-9 * x);
+}
+
+int resamp_init(struct resamp *r, double rate, double out_rate, double pass, double atten, size_t ss) {
+	long l, m;
+
+	memset(r, 0, sizeof(struct resamp));
+	r->rate = rate;
+	r->pass = pass;
+	r->atten = atten;
+	r->ss = ss;
+	if ((out_rate <= 0) || !resamp_ratio(out_rate / rate, RESAMP_MAX_L, &l, &m)) {
+		fprintf(stderr, "resampler: %.0f Hz is no ratio of %.0f Hz with at most %d phases\n",
+			out_rate, rate, RESAMP_MAX_L);
+		return -1;
+	}
+	if (l == m) {
+		fprintf(stderr, "resampler: the output rate is the input rate\n");
+		return -1;
+	}
+	if ((pass <= 0) || (pass >= 1) || (atten < 20)) {
+		fprintf(stderr, "resampler: passband must be between 0 and 1, stopband at least 20 dB\n");
+		return -1;
+	}
+	r->l = l;
+	r->m = m;
+	r->out_rate = rate * l / m;
+
+	// the lower rate's band edge fp, images and aliases kept beyond lo - fp
+	double lo = fmin(rate, r->out_rate), fp = pass * lo / 2, up = rate * l;
+	int n = fir_kaiser_len(fp / up, (lo - fp) / up, atten);
+	r->taps = ((n + l - 1) / l + DSP_ALIGN - 1) / DSP_ALIGN * DSP_ALIGN;
+	if (r->taps > RESAMP_MAX_TAPS) {
+		fprintf(stderr, "resampler: %d taps per phase, too many, decimate with the DDC first\n", r->taps);
+		return -1;
+	}
+	n = r->taps * l;
+	float *proto = malloc(n * sizeof(float));
+	if (!proto || !(r->h = malloc(n * sizeof(float)))) {
+		perror("resampler");
+		free(proto);
+		return -1;
+	}
+	fir_kaiser_lowpass(proto, n, fp / up, (lo - fp) / up, atten);
+	// row p holds the taps at p, p + l, ..., scaled by l for the zeros stuffed in between
+	for (int p = 0; p < l; p++) {
+		for (int i = 0; i < r->taps; i++)
+			r->h[p * r->taps + i] = proto[p + (r->taps - 1 - i) * l] * l;
+	}
+	free(proto);
+	r->hist = r->taps - 1;
+	return 0;
+}
+
+/* <rate>[:<passband>[:<dB>]] */
+int resamp_parse(struct resamp *r, const char *spec, double rate, size_t ss) {
+	double out_rate, pass = 0.8, atten = 80;
+	char *end;
+
+	out_rate = parse_freq(spec, &end);
+	if (end == spec)
+		goto fail;
+	if (*end == ':')
+		pass = strtod(end + 1, &end);
+	if (*end == ':')
+		atten = strtod(end + 1, &end);
+	if (*end)
+		goto fail;
+	return resamp_init(r, rate, out_rate, pass, atten, ss);
+
+fail:
+	fprintf(stderr, "resampler: bad spec %s\n", spec);
+	return -1;
+}
+
+void resamp_free(struct resamp *r) {
+	free(r->h);
+	memset(r, 0, sizeof(struct resamp));
+}
+
+void *resamp_scratch_new(const struct resamp *r, size_t len) {
+	struct resamp_scratch *sc = calloc(1, sizeof(struct resamp_scratch));
+	size_t out = len * r->l / r->m + 1;
+
+	if (!sc)
+		return NULL;
+	sc->re = malloc((r->hist + len) * sizeof(float));
+	sc->im = malloc((r->hist + len) * sizeof(float));
+	sc->yr = malloc(out * sizeof(float));
+	sc->yi = malloc(out * sizeof(float));
+	if (!sc->re || !sc->im || !sc->yr || !sc->yi) {
+		resamp_scratch_free(sc);
+		return NULL;
+	}
+	return sc;
+}
+
+void resamp_scratch_free(void *scratch) {
+	struct resamp_scratch *sc = scratch;
+	free(sc->re);
+	free(sc->im);
+	free(sc->yr);
+	free(sc->yi);
+	free(sc);
+}
+
+/* first output at or after input sample start */
+static uint64_t resamp_first(const struct resamp *r, uint64_t start) {
+	return (start * r->l + r->m - 1) / r->m;
+}
+
+size_t resamp_count(const struct resamp *r, size_t len, uint64_t start) {
+	return resamp_first(r, start + len) - resamp_first(r, start);
+}
+
+size_t resamp_run(const struct resamp *r, void *scratch, const void *in, size_t len, uint64_t start, int16_t *out) {
+	struct resamp_scratch *sc = scratch;
+	size_t cnt = resamp_count(r, len, start);
+	uint64_t t = resamp_first(r, start) * r->m;
+
+	if (!cnt)
+		return 0;
+	iq_to_float(sc->re, sc->im, in, r->hist + len, r->ss);
+	// the first output's taps end on input t / l, hist = taps - 1 in front of start
+	size_t pos = t / r->l - start;
+	fir_resample(sc->yr, sc->yi, sc->re + pos, sc->im + pos, cnt, r->h, r->taps, r->l, r->m, t % r->l);
+	float_to_sc16(out, sc->yr, sc->yi, cnt);
+	return cnt;
+}
+
+double resamp_delay(const struct resamp *r) {
+	return (r->taps * r->l - 1) / 2.0 / r->l;
+}
+
+void resamp_describe(const struct resamp *r, FILE *fl) {
+	fprintf(fl, "# SC16 at out_rate, input full scale = 32767\n");
+	fprintf(fl, "# output sample j is input sample j * m / l - delay\n");
+	fprintf(fl, "in_rate %.0f\n", r->rate);
+	fprintf(fl, "out_rate %.3f\n", r->out_rate);
+	fprintf(fl, "l %d m %d\n", r->l, r->m);
+	fprintf(fl, "passband %.0f\n", r->pass * fmin(r->rate, r->out_rate) / 2);
+	fprintf(fl, "stopband_db %.1f\n", r->atten);
+	fprintf(fl, "taps %d per phase kaiser\n", r->taps);
+	fprintf(fl, "delay %.3f\n", resamp_delay(r));
+}
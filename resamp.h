@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESAMP_H
+#define RESAMP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsp.h"
+
+/*
+ * Rational resampler: out_rate = rate * l / m with l / m in lowest terms.
+ * The lowpass runs at rate * l, but only the row of it (phase) that lands
+ * on an output is computed, from taps input samples. The passband is
+ * pass * the lower of the two rates / 2, like the DDC's, and the output
+ * SC16 at full scale 32767.
+ *
+ * Output j is taken at input time j * m / l. Blocks work like ddc_run()'s
+ * with any start: a block yields the outputs that fall on its new samples.
+ */
+
+#define RESAMP_MAX_L    1024
+
+struct resamp {
+	double rate, out_rate, pass, atten;
+	size_t ss;
+	int l, m;
+	int taps;               // per phase, multiple of DSP_ALIGN
+	float *h;               // l rows of taps, reversed
+	size_t hist;
+};
+
+int  resamp_init(struct resamp *r, double rate, double out_rate, double pass, double atten, size_t ss);
+/* from <out_rate>[:<pass>[:<atten>]], k/M suffixes, pass 0.8 and 80 dB by default */
+int  resamp_parse(struct resamp *r, const char *spec, double rate, size_t ss);
+void resamp_free(struct resamp *r);
+
+void *resamp_scratch_new(const struct resamp *r, size_t len);
+void resamp_scratch_free(void *scratch);
+
+/* outputs falling on len inputs from start, at most len * l / m + 1 */
+size_t resamp_count(const struct resamp *r, size_t len, uint64_t start);
+/* in: hist + len samples, returns the number of SC16 samples in out */
+size_t resamp_run(const struct resamp *r, void *scratch, const void *in, size_t len, uint64_t start, int16_t *out);
+
+/* group delay in input samples */
+double resamp_delay(const struct resamp *r);
+
+/* key value lines for a metadata sidecar */
+void resamp_describe(const struct resamp *r, FILE *fl);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Segmented sink: splits the stream into files of seg_size bytes named
+ * after a printf pattern. While segment n is written, a helper thread
+ * closes n-1 and creates, preallocates and maps n+1, so a rollover is
+ * just a swap. Each segment gets a line in <basename>.manifest when its
+ * first sample arrives.
+ */
+
+#define _GNU_SOURCE
+#include <sys/time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "storage.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+struct seg {
+	int backend;
+	const char *pattern;
+	size_t seg_size;
+	unsigned idx;              // index of cur
+	struct sink cur, old, next;
+	int have_old, have_next;   // owned by the helper while it runs
+	char next_fn[PATH_MAX];
+	pthread_t helper;
+	int helper_running;
+	FILE *manifest;
+	int listed;                // segment 0 has its manifest line
+};
+
+/* capture_%05d.iq -> capture.iq, used as base name for the sidecars */
+void segment_basename(char *dst, size_t len, const char *pattern) {
+	const char *pct = strchr(pattern, '%'), *end = pct;
+	size_t n;
+
+	if (!pct) {
+		snprintf(dst, len, "%s", pattern);
+		return;
+	}
+	while ((end[1] >= '0' && end[1] <= '9') || end[1] == '-')
+		end++;
+	end += 2;   // conversion character
+	n = pct - pattern;
+	if (n && strchr("_-.", pattern[n - 1]))
+		n--;
+	snprintf(dst, len, "%.*s%s", (int)n, pattern, end);
+}
+
+static int seg_open(struct seg *g, struct sink *dst, unsigned idx, size_t size, char *fn) {
+	snprintf(fn, PATH_MAX, g->pattern, idx);
+	if (sink_open(dst, g->backend, fn, size, 0))
+		return -1;
+	// give the next segment its blocks now, not on the first page fault
+	if (g->backend == SINK_MMAP)
+		fallocate(dst->fd, 0, 0, size);   // best effort, sparse works too
+	return 0;
+}
+
+/* helper thread: close the previous segment, prepare the next one */
+static void *seg_helper(void *arg) {
+	struct sink *s = arg;
+	struct seg *g = s->priv;
+	size_t left = s->size - MIN(s->size, (size_t)(g->idx + 1) * g->seg_size);
+
+	if (g->have_old) {
+		sink_close(&g->old);
+		g->have_old = 0;
+	}
+	if (left && !g->have_next)
+		g->have_next = !seg_open(g, &g->next, g->idx + 1, MIN(left, g->seg_size), g->next_fn);
+	return NULL;
+}
+
+static void seg_manifest(struct sink *s, const char *fn) {
+	struct seg *g = s->priv;
+	struct timeval tv;
+
+	if (!g->manifest)
+		return;
+	gettimeofday(&tv, NULL);
+	fprintf(g->manifest, "%s %zu %ld.%06ld %" PRIu64 "\n", fn, s->written / s->ss, tv.tv_sec, (long)tv.tv_usec, sink_ts(s));
+	fflush(g->manifest);
+}
+
+/* segment 0 is listed with its first sample, when the stream has been marked */
+static void seg_list_first(struct sink *s) {
+	struct seg *g = s->priv;
+	char fn[PATH_MAX];
+
+	if (g->listed)
+		return;
+	g->listed = 1;
+	snprintf(fn, sizeof(fn), g->pattern, 0);
+	seg_manifest(s, fn);
+}
+
+static int seg_start_helper(struct sink *s) {
+	struct seg *g = s->priv;
+	g->helper_running = !pthread_create(&g->helper, NULL, seg_helper, s);
+	if (!g->helper_running)
+		seg_helper(s);
+	return 0;
+}
+
+static void seg_join_helper(struct sink *s) {
+	struct seg *g = s->priv;
+	if (!g->helper_running)
+		return;
+	struct timeval t0, t1;
+	gettimeofday(&t0, NULL);
+	pthread_join(g->helper, NULL);
+	gettimeofday(&t1, NULL);
+	s->stall_us += (t1.tv_sec - t0.tv_sec) * 1000000ULL + (t1.tv_usec - t0.tv_usec);
+	g->helper_running = 0;
+}
+
+/* current segment is full: swap in the prepared one */
+static int seg_next(struct sink *s) {
+	struct seg *g = s->priv;
+	int res;
+
+	if (s->written >= s->size)
+		return 0;
+	// buffers still in flight must come back on this thread
+	if ((res = sink_flush(&g->cur)))
+		return res;
+	seg_join_helper(s);
+	if (!g->have_next) {
+		fprintf(stderr, "\nsegment %u not ready\n", g->idx + 1);
+		return -1;
+	}
+	g->old = g->cur;
+	g->have_old = 1;
+	g->cur = g->next;
+	g->have_next = 0;
+	g->idx++;
+	seg_manifest(s, g->next_fn);
+	return seg_start_helper(s);
+}
+
+static void seg_route(struct sink *s) {
+	struct seg *g = s->priv;
+	g->cur.release = s->release;
+	g->cur.release_ctx = s->release_ctx;
+}
+
+static int seg_get(struct sink *s, void **dst, size_t *len) {
+	struct seg *g = s->priv;
+	if (!sink_space(&g->cur) && seg_next(s))
+		return -1;
+	*len = MIN(*len, s->size - s->written);
+	if (!*len)
+		return 0;
+	return sink_get(&g->cur, dst, len);
+}
+
+static int seg_put(struct sink *s, size_t len) {
+	struct seg *g = s->priv;
+	seg_list_first(s);
+	s->written += len;
+	return sink_put(&g->cur, len);
+}
+
+static int seg_write(struct sink *s, void *data, size_t len, void *tag) {
+	struct seg *g = s->priv;
+	int res;
+
+	if (!sink_space(&g->cur) && seg_next(s))
+		return -1;
+	seg_list_first(s);
+	seg_route(s);
+	if (len <= sink_space(&g->cur)) {
+		s->written += len;
+		return sink_write(&g->cur, data, len, tag);
+	}
+	// straddles the boundary
+	res = sink_copy(s, data, len);
+	s->release(s->release_ctx, tag);
+	return res;
+}
+
+static int seg_flush(struct sink *s) {
+	struct seg *g = s->priv;
+	seg_route(s);
+	return sink_flush(&g->cur);
+}
+
+static void seg_close(struct sink *s) {
+	struct seg *g = s->priv;
+
+	seg_flush(s);
+	seg_join_helper(s);
+	sink_close(&g->cur);
+	if (g->have_old)
+		sink_close(&g->old);
+	if (g->have_next) {
+		// prepared but never used
+		sink_close(&g->next);
+		unlink(g->next_fn);
+	}
+	if (g->manifest)
+		fclose(g->manifest);
+	free(g);
+}
+
+static int seg_open_all(struct sink *s, const char *fn) {
+	struct seg *g = s->priv;
+	char base[PATH_MAX], first[PATH_MAX];
+
+	segment_basename(base, sizeof(base), fn);
+	if (seg_open(g, &g->cur, 0, MIN(s->size, g->seg_size), first))
+		return -1;
+	g->manifest = sidecar_open(base, "manifest");
+	if (g->manifest)
+		fputs("# file first_sample unix_time device_timestamp\n", g->manifest);
+	return seg_start_helper(s);
+}
+
+static const struct sink_ops seg_ops = {
+	.name  = "segmented",
+	.open  = seg_open_all,
+	.get   = seg_get,
+	.put   = seg_put,
+	.write = seg_write,
+	.flush = seg_flush,
+	.close = seg_close,
+};
+
+int sink_open_segmented(struct sink *s, int backend, const char *pattern, size_t max_size, size_t seg_size) {
+	struct seg *g = calloc(1, sizeof(struct seg));
+	if (!g)
+		return -1;
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &seg_ops;
+	s->size = max_size;
+	s->ss = sink_sample_size;
+	s->priv = g;
+	g->backend = backend;
+	g->pattern = pattern;
+	// segment boundaries on whole 4 KiB blocks keep O_DIRECT writes aligned
+	g->seg_size = MIN(seg_size, max_size);
+	g->seg_size = (g->seg_size > 4096) ? g->seg_size & ~(size_t)4095 : g->seg_size;
+	if (seg_open_all(s, pattern)) {
+		free(g);
+		return -1;
+	}
+	return 0;
+}
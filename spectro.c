@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spectro.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b)    ((a)>=(b)?(a):(b))
+#endif
+
+int spectro_parse(struct spectro *s, const char *spec, double rate, size_t ss) {
+	double secs = 0.1;
+	char *end;
+	long n = strtol(spec, &end, 10);
+
+	memset(s, 0, sizeof(struct spectro));
+	if (*end == ':')
+		secs = strtod(end + 1, &end);
+	if ((end == spec) || *end || (secs <= 0)) {
+		fprintf(stderr, "spectrogram: bad spec %s\n", spec);
+		return -1;
+	}
+	if ((n < SPEC_MIN_FFT) || (n > SPEC_MAX_FFT) || (n & (n - 1))) {
+		fprintf(stderr, "spectrogram: FFT size must be a power of 2 from %d to %d\n", SPEC_MIN_FFT, SPEC_MAX_FFT);
+		return -1;
+	}
+	s->rate = rate;
+	s->ss = ss;
+	s->n = n;
+	s->frames = fmax(1, fmin(lrint(secs * rate / n), 1 << 30));
+
+	s->win = malloc(n * sizeof(float));
+	s->re = malloc(n * sizeof(float));
+	s->im = malloc(n * sizeof(float));
+	s->sum = calloc(n, sizeof(float));
+	s->peak = calloc(n, sizeof(float));
+	s->row = malloc(2 * n);
+	if (!s->win || !s->re || !s->im || !s->sum || !s->peak || !s->row || fft_init(&s->fft, n)) {
+		perror("spectrogram");
+		spectro_close(s);
+		return -1;
+	}
+	double wsum = 0;
+	for (int i = 0; i < n; i++) {
+		s->win[i] = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+		wsum += s->win[i];
+	}
+	s->scale = 1 / (wsum * wsum);
+	return 0;
+}
+
+int spectro_open(struct spectro *s, FILE *fl) {
+	struct spec_header h = {
+		.magic = SPEC_MAGIC, .version = 1, .ss = s->ss, .fft = s->n, .frames = s->frames, .rate = s->rate,
+	};
+	s->fl = fl;
+	if (fwrite(&h, sizeof(h), 1, fl) != 1) {
+		perror("spectrogram");
+		return -1;
+	}
+	return 0;
+}
+
+int spectro_open_index(struct spectro *s, FILE *fl, int bands, int linear) {
+	struct act_header h = {
+		.magic = ACT_MAGIC, .version = 1, .ss = s->ss, .fft = s->n, .frames = s->frames, .rate = s->rate,
+		.bands = bands, .linear = !!linear,
+	};
+	if ((bands < 1) || (bands > MIN(s->n, ACT_MAX_BANDS)) || (bands & (bands - 1))) {
+		fprintf(stderr, "activity index: bands must be a power of 2 up to %d and the FFT size\n", ACT_MAX_BANDS);
+		return -1;
+	}
+	s->act = fl;
+	s->bands = bands;
+	if (!(s->band = calloc(bands, sizeof(struct act_band))) || (fwrite(&h, sizeof(h), 1, fl) != 1)) {
+		perror("activity index");
+		return -1;
+	}
+	return 0;
+}
+
+static uint8_t spectro_db(float p) {
+	float v = 255 + 20 * log10f(p + 1e-30f);
+	return (v <= 0) ? 0 : (v >= 255) ? 255 : (uint8_t)(v + 0.5f);
+}
+
+/* per band level, peak and occupancy of a finished row */
+static int spectro_index(struct spectro *s, float mean) {
+	int n = s->n, h = n / 2, w = n / s->bands;
+	size_t hist[256] = {0}, cnt = 0;
+	struct act_row r = { .start = s->hdr.start, .frames = s->hdr.frames };
+
+	for (int i = 0; i < n; i++)
+		hist[s->row[i]]++;
+	while ((cnt += hist[r.floor]) <= (size_t)h)
+		r.floor++;
+	int occ = MIN(r.floor + 2 * ACT_OCC_DB, 255);
+
+	for (int b = 0; b < s->bands; b++) {
+		float sum = 0;
+		int peak = 0, busy = 0;
+		for (int i = b * w; i < (b + 1) * w; i++) {
+			sum += s->sum[(i + h) & (n - 1)];
+			peak = MAX(peak, s->row[n + i]);
+			busy += s->row[i] > occ;
+		}
+		s->band[b].level = spectro_db(sum * mean);
+		s->band[b].peak = peak;
+		s->band[b].occ = (busy * 255 + w / 2) / w;
+	}
+	if ((fwrite(&r, sizeof(r), 1, s->act) != 1) ||
+			(fwrite(s->band, sizeof(struct act_band), s->bands, s->act) != (size_t)s->bands) || fflush(s->act)) {
+		perror("activity index");
+		return -1;
+	}
+	return 0;
+}
+
+/* fftshifted mean and peak of the frames summed up so far */
+static int spectro_row(struct spectro *s) {
+	int n = s->n, h = n / 2;
+	float mean = s->scale / s->done;
+
+	for (int i = 0; i < n; i++) {
+		int k = (i + h) & (n - 1);
+		s->row[i] = spectro_db(s->sum[k] * mean);
+		s->row[n + i] = spectro_db(s->peak[k] * s->scale);
+	}
+	s->hdr.frames = s->done;
+	if (s->fl && ((fwrite(&s->hdr, sizeof(s->hdr), 1, s->fl) != 1) || (fwrite(s->row, 2 * n, 1, s->fl) != 1) ||
+			fflush(s->fl))) {
+		perror("spectrogram");
+		return -1;
+	}
+	if (s->act && spectro_index(s, mean))
+		return -1;
+	memset(s->sum, 0, n * sizeof(float));
+	memset(s->peak, 0, n * sizeof(float));
+	s->done = 0;
+	s->hdr.skipped = 0;
+	return 0;
+}
+
+int spectro_run(struct spectro *s, const void *iq, size_t n, uint64_t pos) {
+	const uint8_t *p = iq;
+
+	if (pos != s->next) {
+		// the partial frame and whatever fit in the gap are lost
+		uint64_t lost = s->fill + ((pos > s->next) ? pos - s->next : 0);
+		s->hdr.skipped += (lost + s->n - 1) / s->n;
+		s->fill = 0;
+	}
+	s->next = pos + n;
+	while (n) {
+		size_t k = MIN(n, (size_t)(s->n - s->fill));
+		if (!s->fill && !s->done)
+			s->hdr.start = pos;
+		iq_to_float(s->re + s->fill, s->im + s->fill, p, k, s->ss);
+		s->fill += k;
+		p += k * s->ss;
+		pos += k;
+		n -= k;
+		if (s->fill < s->n)
+			break;
+		win_apply(s->re, s->im, s->win, s->n);
+		fft_run(&s->fft, s->re, s->im, 0);
+		power_accum(s->sum, s->peak, s->re, s->im, s->n);
+		s->fill = 0;
+		if ((++s->done == s->frames) && spectro_row(s))
+			return -1;
+	}
+	return 0;
+}
+
+int spectro_close(struct spectro *s) {
+	int res = 0;
+
+	if (s->done && (s->fl || s->act))
+		res = spectro_row(s);
+	if (s->fl)
+		fclose(s->fl);
+	if (s->act)
+		fclose(s->act);
+	free(s->band);
+	free(s->win);
+	free(s->re);
+	free(s->im);
+	free(s->sum);
+	free(s->peak);
+	free(s->row);
+	fft_free(&s->fft);
+	memset(s, 0, sizeof(struct spectro));
+	return res;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPECTRO_H
+#define SPECTRO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsp.h"
+
+/*
+ * Spectrogram sidecar: averaged power spectra of the received band, so a
+ * long capture can be searched and rendered without reading it back.
+ *
+ *     spec_header | spec_row, mean[fft], peak[fft] | spec_row ... | ...
+ *
+ * Frames of fft samples are Hann windowed and transformed back to back,
+ * a row sums up frames of them: mean is their average power, peak the
+ * highest of each bin. Bins go from -rate / 2 to rate / 2 (fftshifted),
+ * one byte each: 255 + 2 * dB relative to a full scale tone, so 0.5 dB
+ * steps down to -127.5 dBFS. All fields little endian.
+ *
+ * The activity index condenses each row into bands equal sub-bands for
+ * range queries over long captures:
+ *
+ *     act_header | act_row, act_band[bands] | ...
+ *
+ * level is the band's total mean power, peak its highest peak bin, both
+ * coded like the spectrogram's bins; occupancy the share of its bins
+ * ACT_OCC_DB above the row's median bin (the noise floor), 255 = all.
+ *
+ * During a capture it runs on the tap worker (tap.h). A row counts the
+ * frames that went into it and the ones lost to drops or gaps.
+ */
+
+#define SPEC_MAGIC      "IQS1"
+#define SPEC_MIN_FFT    64
+#define SPEC_MAX_FFT    (1 << 16)
+
+#define ACT_MAGIC       "IQA1"
+#define ACT_MAX_BANDS   256
+#define ACT_OCC_DB      10
+
+struct spec_header {
+	char magic[4];
+	uint16_t version;      // 1
+	uint16_t ss;           // bytes per sample of the stream
+	uint32_t fft;
+	uint32_t frames;       // per row
+	double rate;
+	uint32_t reserved[4];
+};
+
+struct spec_row {
+	uint64_t start;        // stream sample of the first frame
+	uint32_t frames;       // averaged, fewer in the last row
+	uint32_t skipped;      // frames lost to drops and gaps in between
+};
+
+struct act_header {
+	char magic[4];
+	uint16_t version;      // 1
+	uint16_t ss;
+	uint32_t fft;
+	uint32_t frames;
+	double rate;
+	uint32_t bands;        // band i covers -rate / 2 + [i, i + 1) * rate / bands
+	uint32_t linear;       // 1: the capture holds stream sample k at byte k * ss
+	uint32_t reserved[2];
+};
+
+struct act_row {
+	uint64_t start;
+	uint32_t frames;
+	uint8_t floor;         // median bin, coded like the bins
+	uint8_t reserved[3];
+};
+
+struct act_band {
+	uint8_t level, peak, occ;
+};
+
+struct spectro {
+	double rate;
+	size_t ss;
+	int n, frames;
+	float *win, scale;          // Hann window, 1 / sum(win)^2
+	float *re, *im, *sum, *peak;
+	uint8_t *row;
+	struct fft fft;
+	FILE *fl;                   // spectrogram, NULL: off
+	FILE *act;                  // activity index, NULL: off
+	int bands;
+	struct act_band *band;
+
+	// frame being filled, row being summed up
+	int fill, done;
+	uint64_t next;              // stream sample expected next
+	struct spec_row hdr;
+};
+
+/* <fft>[:<seconds>], integration time 0.1 s by default */
+int  spectro_parse(struct spectro *s, const char *spec, double rate, size_t ss);
+/* writes the header, rows follow as they complete */
+int  spectro_open(struct spectro *s, FILE *fl);
+/*
+ * the same for the activity index, bands a power of 2 up to the FFT size,
+ * linear: the capture is a plain sc16 / sc8 file ranges can be copied from
+ */
+int  spectro_open_index(struct spectro *s, FILE *fl, int bands, int linear);
+/* n samples at stream sample pos, on the calling thread */
+int  spectro_run(struct spectro *s, const void *iq, size_t n, uint64_t pos);
+/* writes the partial last row, closes the files and frees everything */
+int  spectro_close(struct spectro *s);
+
+/* seconds per row */
+static inline double spectro_row_time(const struct spectro *s) {
+	return (double)s->n * s->frames / s->rate;
+}
+
+#endif
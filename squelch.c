@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Squelch sink: stores only what's around bursts of energy. The stream is
+ * cut into SQUELCH_WINDOW sample windows and their mean power compared to
+ * a threshold: above it opens, and it stays open until the power has been
+ * below threshold - hysteresis for post samples. The pre samples in front
+ * of an opening are held back while closed and stored with it.
+ *
+ * Every stretch left out is a line in <base>.squelch, so the stream time of
+ * any stored sample is its file position plus the samples dropped before
+ * it. Sizes and positions of this sink count received bytes, the inner
+ * one's stored bytes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "storage.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define SQUELCH_WINDOW  1024        // samples
+#define STAGE_SIZE      (1 << 20)   // get()/put() staging, bytes
+
+typedef int v8si __attribute__((vector_size(32)));
+typedef float v8sf __attribute__((vector_size(32)));
+
+#if defined(__x86_64__)
+#define MULTIVERSION    __attribute__((target_clones("avx2", "default")))
+#else
+#define MULTIVERSION
+#endif
+
+struct squelch {
+	struct sink *inner;
+	size_t ss, win;             // bytes per sample, per window
+	double open, close;         // window energy thresholds
+	size_t post;                // windows kept after the last loud one
+	int is_open;
+	size_t hold;                // windows left until it closes
+
+	// held back while closed: a ring of pre windows, the oldest is dropped
+	uint8_t *ring;
+	size_t pre, head, fill;
+
+	uint8_t *carry;             // partial window across calls
+	size_t carry_len;
+	uint8_t *stage;
+
+	uint64_t drop_start, dropped, total_dropped;   // samples
+	size_t bursts;
+	FILE *index;
+};
+
+/* sum of |x|^2 over a window, a 32 bit lane holds one SC16 sample or two SC8 ones */
+MULTIVERSION
+static double window_energy(const uint8_t *p, size_t n, size_t ss) {
+	v8sf acc = {0};
+	for (size_t i = 0; i < n * ss; i += sizeof(v8si)) {
+		v8si w, x, y;
+		memcpy(&w, p + i, sizeof(w));
+		if (ss == 2) {
+			x = (w << 24) >> 24;
+			y = (w << 16) >> 24;
+			acc += __builtin_convertvector(x * x + y * y, v8sf);
+			x = (w << 8) >> 24;
+			y = w >> 24;
+		}
+		else {
+			x = (w << 16) >> 16;
+			y = w >> 16;
+		}
+		// an exact int32 square sum, short of full scale -32768 on both
+		acc += __builtin_convertvector(x * x + y * y, v8sf);
+	}
+	return ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+/* the dropped stretch ends here */
+static void squelch_log(struct sink *s) {
+	struct squelch *sq = s->priv;
+	if (!sq->dropped)
+		return;
+	fprintf(sq->index, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n", sq->drop_start,
+			(uint64_t)(sq->inner->written / sq->ss), sq->dropped);
+	sq->total_dropped += sq->dropped;
+	sq->dropped = 0;
+}
+
+/* stores bytes that sit at input offset pos */
+static int squelch_store(struct sink *s, const uint8_t *p, size_t len, size_t pos) {
+	struct squelch *sq = s->priv;
+	// held back windows can lie in front of the last mark
+	sink_mark(sq->inner, s->mark_ts + ((int64_t)pos - (int64_t)s->mark_pos) / (int64_t)sq->ss);
+	return sink_copy(sq->inner, p, len);
+}
+
+/* one window at input offset pos, *stored: the caller stores it, else it's held back or dropped */
+static int squelch_window(struct sink *s, const uint8_t *p, size_t pos, int *stored) {
+	struct squelch *sq = s->priv;
+	double e = window_energy(p, SQUELCH_WINDOW, sq->ss);
+	int res = 0;
+
+	*stored = 0;
+	if (sq->is_open) {
+		if (e > sq->close)
+			sq->hold = sq->post;
+		else if (!sq->hold--)
+			sq->is_open = 0;
+	}
+	else if (e > sq->open) {
+		// the ring holds the pre windows right in front of this one
+		sq->is_open = 1;
+		sq->hold = sq->post;
+		sq->bursts++;
+		squelch_log(s);
+		size_t at = pos - sq->fill * sq->win;
+		for (size_t k = 0; !res && (k < sq->fill); k++) {
+			size_t slot = (sq->head + sq->pre - sq->fill + k) % sq->pre;
+			res = squelch_store(s, sq->ring + slot * sq->win, sq->win, at + k * sq->win);
+		}
+		sq->fill = 0;
+	}
+	if (sq->is_open) {
+		*stored = 1;
+		return res;
+	}
+	if (!sq->pre) {
+		if (!sq->dropped)
+			sq->drop_start = pos / sq->ss;
+		sq->dropped += SQUELCH_WINDOW;
+		return 0;
+	}
+	if (sq->fill == sq->pre) {
+		// the oldest held back window falls out
+		if (!sq->dropped)
+			sq->drop_start = (pos - sq->pre * sq->win) / sq->ss;
+		sq->dropped += SQUELCH_WINDOW;
+		sq->fill--;
+	}
+	memcpy(sq->ring + sq->head * sq->win, p, sq->win);
+	sq->head = (sq->head + 1) % sq->pre;
+	sq->fill++;
+	return 0;
+}
+
+static int squelch_in(struct sink *s, const uint8_t *p, size_t len) {
+	struct squelch *sq = s->priv;
+	size_t pos = s->written, run = 0, run_pos = 0;
+	int res = 0, stored;
+
+	len = MIN(len, s->size - s->written);
+	s->written += len;
+	if (sq->carry_len) {
+		size_t k = MIN(len, sq->win - sq->carry_len);
+		memcpy(sq->carry + sq->carry_len, p, k);
+		sq->carry_len += k;
+		p += k;
+		len -= k;
+		pos += k;
+		if (sq->carry_len < sq->win)
+			return 0;
+		sq->carry_len = 0;
+		if ((res = squelch_window(s, sq->carry, pos - sq->win, &stored)))
+			return res;
+		if (stored && (res = squelch_store(s, sq->carry, sq->win, pos - sq->win)))
+			return res;
+	}
+	// consecutive windows to store go to the inner sink in one piece
+	for (; len >= sq->win; p += sq->win, len -= sq->win, pos += sq->win) {
+		if ((res = squelch_window(s, p, pos, &stored)))
+			return res;
+		if (stored) {
+			if (!run)
+				run_pos = pos;
+			run += sq->win;
+			continue;
+		}
+		if (run && (res = squelch_store(s, p - run, run, run_pos)))
+			return res;
+		run = 0;
+	}
+	if (run && (res = squelch_store(s, p - run, run, run_pos)))
+		return res;
+	memcpy(sq->carry, p, len);
+	sq->carry_len = len;
+	sq->inner->stall_us = s->stall_us;
+	return 0;
+}
+
+static int squelch_get(struct sink *s, void **dst, size_t *len) {
+	struct squelch *sq = s->priv;
+	*len = MIN(*len, MIN((size_t)STAGE_SIZE, s->size - s->written));
+	*dst = sq->stage;
+	return 0;
+}
+
+static int squelch_put(struct sink *s, size_t len) {
+	struct squelch *sq = s->priv;
+	return squelch_in(s, sq->stage, len);
+}
+
+static int squelch_write(struct sink *s, void *data, size_t len, void *tag) {
+	int res = squelch_in(s, data, len);
+	s->release(s->release_ctx, tag);
+	return res;
+}
+
+static int squelch_flush(struct sink *s) {
+	struct squelch *sq = s->priv;
+	return sink_flush(sq->inner);
+}
+
+/* what's still held back or in a partial window was quiet, it's dropped */
+static void squelch_close(struct sink *s) {
+	struct squelch *sq = s->priv;
+	size_t tail = sq->carry_len / sq->ss + (sq->is_open ? 0 : sq->fill * SQUELCH_WINDOW);
+
+	if (tail && sq->is_open) {
+		squelch_store(s, sq->carry, sq->carry_len, s->written - sq->carry_len);
+		tail = 0;
+	}
+	if (tail) {
+		if (!sq->dropped)
+			sq->drop_start = s->written / sq->ss - tail;
+		sq->dropped += tail;
+	}
+	squelch_log(s);
+	fclose(sq->index);
+	sink_close(sq->inner);
+	free(sq->ring);
+	free(sq->carry);
+	free(sq->stage);
+	free(sq);
+}
+
+static const struct sink_ops squelch_ops = {
+	.name  = "squelch",
+	.get   = squelch_get,
+	.put   = squelch_put,
+	.write = squelch_write,
+	.flush = squelch_flush,
+	.close = squelch_close,
+};
+
+/* inner: an open sink sized for max_size, closed along with s; pre, post in samples */
+int sink_open_squelch(struct sink *s, struct sink *inner, size_t max_size, const char *base,
+	float dbfs, float hyst, size_t pre, size_t post)
+{
+	struct squelch *sq = calloc(1, sizeof(struct squelch));
+	size_t ss = inner->ss, fs = (ss == 2) ? 128 : 2048;
+
+	if (!sq) {
+		perror("squelch");
+		sink_close(inner);
+		return -1;
+	}
+	sq->inner = inner;
+	sq->ss = ss;
+	sq->win = SQUELCH_WINDOW * ss;
+	sq->open = pow(10, dbfs / 10) * fs * fs * SQUELCH_WINDOW;
+	sq->close = pow(10, (dbfs - hyst) / 10) * fs * fs * SQUELCH_WINDOW;
+	sq->pre = (pre + SQUELCH_WINDOW - 1) / SQUELCH_WINDOW;
+	sq->post = (post + SQUELCH_WINDOW - 1) / SQUELCH_WINDOW;
+	sq->ring = malloc(sq->pre * sq->win + 1);
+	sq->carry = malloc(sq->win);
+	sq->stage = malloc(STAGE_SIZE);
+	if (!sq->ring || !sq->carry || !sq->stage)
+		perror("squelch");
+	if (!sq->ring || !sq->carry || !sq->stage || !(sq->index = sidecar_open(base, "squelch"))) {
+		free(sq->ring);
+		free(sq->carry);
+		free(sq->stage);
+		free(sq);
+		sink_close(inner);
+		return -1;
+	}
+	fprintf(sq->index, "# open %.1f dBFS close %.1f dBFS window %d pre %zu post %zu samples\n",
+		dbfs, dbfs - hyst, SQUELCH_WINDOW, sq->pre * SQUELCH_WINDOW, sq->post * SQUELCH_WINDOW);
+	fprintf(sq->index, "# stream_sample file_sample dropped_samples\n");
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &squelch_ops;
+	s->size = max_size / ss * ss;
+	s->ss = ss;
+	s->priv = sq;
+	return 0;
+}
+
+void sink_squelch_stats(struct sink *s, uint64_t *dropped, size_t *bursts) {
+	struct squelch *sq = s->priv;
+	*dropped = sq->total_dropped + sq->dropped;
+	*bursts = sq->bursts;
+}
@@ -0,0 +1,821 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <linux/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/time.h>
+#include <linux/magic.h>
+#include <liburing.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+
+#include "storage.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b)    ((a)>=(b)?(a):(b))
+#endif
+
+static int open_excl(const char *fn, int flags) {
+	int fd = open(fn, O_CREAT | O_EXCL | O_RDWR | flags, S_IRUSR | S_IWUSR | S_IRGRP);
+	if (fd < 0)
+		perror("open");
+	return fd;
+}
+
+/* copy caller memory into the sink, split as the backend demands */
+int sink_copy(struct sink *s, const void *data, size_t len) {
+	const uint8_t *src = data;
+	while (len) {
+		size_t n = len;
+		void *dst;
+		int res = sink_get(s, &dst, &n);
+		if (res)
+			return res;
+		if (!n)
+			return -1;     // sink full
+		memcpy(dst, src, n);
+		if ((res = sink_put(s, n)))
+			return res;
+		src += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int sink_zero(struct sink *s, size_t len) {
+	while (len) {
+		size_t n = len;
+		void *dst;
+		int res = sink_get(s, &dst, &n);
+		if (res)
+			return res;
+		if (!n)
+			return -1;
+		memset(dst, 0, n);
+		if ((res = sink_put(s, n)))
+			return res;
+		len -= n;
+	}
+	return 0;
+}
+
+/* <base>.<ext> next to the capture file, never overwrites */
+FILE *sidecar_open(const char *base, const char *ext) {
+	char fn[PATH_MAX];
+	snprintf(fn, sizeof(fn), "%s.%s", base, ext);
+	FILE *fl = fopen(fn, "wx");
+	if (!fl)
+		perror(fn);
+	return fl;
+}
+
+size_t sink_sample_size = 4;
+
+/*
+ * Anonymous sample memory (buffer pool, io buffers, stripe blocks),
+ * populated up front. With sink_hugepages set, it comes from hugetlb
+ * pages if the kernel has some reserved (1 GiB pages for large requests,
+ * else 2 MiB), otherwise transparent hugepages are requested. *size is
+ * rounded up to what was mapped, pass it to buf_free().
+ */
+int sink_hugepages = 0;
+
+void *buf_alloc(size_t *size, const char *what) {
+	static const struct {
+		int flags;
+		size_t page;
+		const char *name;
+	} huge[] = {
+		{ MAP_HUGETLB | MAP_HUGE_1GB, 1UL << 30, "1 GiB" },
+		{ MAP_HUGETLB | MAP_HUGE_2MB, 2UL << 20, "2 MiB" },
+	};
+	void *p;
+
+	for (size_t i = 0; sink_hugepages && (i < sizeof(huge) / sizeof(huge[0])); i++) {
+		size_t len = (*size + huge[i].page - 1) & ~(huge[i].page - 1);
+		if ((huge[i].page > (2UL << 20)) && (*size < huge[i].page))
+			continue;
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | huge[i].flags, -1, 0);
+		if (p != MAP_FAILED) {
+			fprintf(stderr, "%s: %zu MiB in %s hugepages\n", what, len >> 20, huge[i].name);
+			*size = len;
+			return p;
+		}
+	}
+	p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | (sink_hugepages ? 0 : MAP_POPULATE), -1, 0);
+	if (p == MAP_FAILED) {
+		perror(what);
+		return NULL;
+	}
+	if (sink_hugepages) {
+		// has to be asked for before the first touch
+		int thp = !madvise(p, *size, MADV_HUGEPAGE);
+		memset(p, 0, *size);
+		fprintf(stderr, "%s: no hugetlb pages reserved, %zu MiB in %s\n", what, *size >> 20,
+			thp ? "transparent hugepages where the kernel allows" : "4 KiB pages");
+	}
+	return p;
+}
+
+void buf_free(void *p, size_t size) {
+	if (p)
+		munmap(p, size);
+}
+
+/* ---------------------------------------------------------------- mmap --- */
+
+/*
+ * Only a window of the file is mapped: the chunk being written and the
+ * next one, which a helper thread maps ahead of time, so page tables and
+ * address space stay the same size however long the capture runs.
+ *
+ * Left alone, the kernel also lets gigabytes of the mapping go dirty and
+ * then throttles the RX thread while it catches up. So the same helper
+ * starts writeback of every completed window right away, waits for the
+ * one before it and drops it from the page cache, so at most about
+ * sink_dirty_max bytes are dirty at any time and close has little left
+ * to sync. get() blocks if the disk falls behind by more than that.
+ *
+ * Ahead of the write pointer, the helper allocates and faults in the next
+ * sink_prefault bytes, so the RX side finds its pages ready instead of
+ * taking a fault per 4 KiB inside bladerf_sync_rx().
+ */
+size_t sink_dirty_max = 256UL * 1000 * 1000;
+size_t sink_prefault = 64UL * 1000 * 1000;
+
+#define WB_POLL_NS  1000000
+#define MAP_CHUNK   (1UL << 30)     // files up to twice this are mapped whole
+#define MAP_VIEWS   3
+#define NO_CHUNK    SIZE_MAX
+#define PREFAULT_STEP   (2UL << 20)
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23      // Linux 5.14
+#endif
+
+struct view {
+	size_t chunk;               // NO_CHUNK: unused
+	uint8_t *base;
+};
+
+struct mf {
+	size_t size;
+	int fd, ring;               // copies for the helper, segments move struct sink
+	size_t chunk, nchunks;      // mapping granularity
+	size_t huge;                // hugetlbfs page size, 0: other fs
+	int thp;                    // ask for transparent hugepages (tmpfs)
+	struct view view[MAP_VIEWS];    // owned by the helper once it runs
+	uint8_t *cur;               // RX side: mapping of cur_chunk
+	size_t cur_chunk;
+	_Atomic size_t rx_chunk;    // chunk the RX side is in
+	_Atomic size_t next_chunk;  // mapped ahead by the helper
+	uint8_t *next;
+	size_t window;              // writeback granularity, 0: off
+	_Atomic size_t head;        // bytes put
+	_Atomic size_t clean;       // bytes written back and dropped
+	size_t faulted;             // stream position prefaulted up to
+	int populate;               // MADV_POPULATE_WRITE works
+	_Atomic int stop;
+	_Atomic int failed;
+	pthread_t helper;
+	int helper_running;
+};
+
+static size_t chunk_len(struct mf *mf, size_t c) {
+	return MIN(mf->chunk, mf->size - c * mf->chunk);
+}
+
+static uint8_t *map_chunk(struct mf *mf, size_t c) {
+	void *p = mmap(NULL, chunk_len(mf, c), PROT_WRITE, MAP_SHARED | MAP_NORESERVE, mf->fd, c * mf->chunk);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	if (mf->thp)
+		madvise(p, chunk_len(mf, c), MADV_HUGEPAGE);
+	return p;
+}
+
+static struct view *find_view(struct mf *mf, size_t c) {
+	for (int i = 0; i < MAP_VIEWS; i++) {
+		if (mf->view[i].chunk == c)
+			return &mf->view[i];
+	}
+	return NULL;
+}
+
+/* unmap what the RX side left behind, map the chunk it needs next */
+static int mmap_views(struct mf *mf) {
+	size_t c = atomic_load(&mf->rx_chunk), n = c + 1;
+	struct view *v;
+
+	if (n == mf->nchunks)
+		n = mf->ring ? 0 : NO_CHUNK;
+	if (n == c)
+		n = NO_CHUNK;
+	for (int i = 0; i < MAP_VIEWS; i++) {
+		v = &mf->view[i];
+		if ((v->chunk != NO_CHUNK) && (v->chunk != c) && (v->chunk != n)) {
+			munmap(v->base, chunk_len(mf, v->chunk));
+			v->chunk = NO_CHUNK;
+		}
+	}
+	if ((n == NO_CHUNK) || (atomic_load(&mf->next_chunk) == n))
+		return 0;
+	// a small ring wraps into a chunk that is still mapped
+	if (!(v = find_view(mf, n))) {
+		v = find_view(mf, NO_CHUNK);
+		if (!(v->base = map_chunk(mf, n))) {
+			atomic_store(&mf->failed, 1);
+			return 0;
+		}
+		v->chunk = n;
+	}
+	mf->next = v->base;
+	atomic_store_explicit(&mf->next_chunk, n, memory_order_release);
+	return 1;
+}
+
+/* stream range [from, to) -> file ranges, split where a ring wraps or a chunk ends */
+static void mmap_wb_range(struct mf *mf, size_t from, size_t to, unsigned flags, int drop) {
+	while (from < to) {
+		size_t ofs = mf->ring ? from % mf->size : from;
+		size_t c = ofs / mf->chunk;
+		size_t len = MIN(to - from, c * mf->chunk + chunk_len(mf, c) - ofs);
+		if (sync_file_range(mf->fd, ofs, len, flags) != 0)
+			perror("sync_file_range");
+		if (drop) {
+			// unmap first, the page cache won't let go of mapped pages
+			struct view *v = find_view(mf, c);
+			if (v)
+				madvise(v->base + ofs - c * mf->chunk, len, MADV_DONTNEED);
+			posix_fadvise(mf->fd, ofs, len, POSIX_FADV_DONTNEED);
+		}
+		from += len;
+	}
+}
+
+/* before Linux 5.14 only the blocks get allocated: a store to touch the pages
+ * could hit samples RX is receiving into, or a ring's older ones */
+static void populate(struct mf *mf, uint8_t *p, size_t len) {
+	if (mf->populate && madvise(p, len, MADV_POPULATE_WRITE))
+		mf->populate = 0;
+}
+
+/* fault in the mapped part of the next sink_prefault bytes, returns 1 if it did some */
+static int mmap_prefault(struct mf *mf) {
+	size_t head = atomic_load(&mf->head), end = head + sink_prefault;
+	int steps = 0;
+
+	if (!mf->ring)
+		end = MIN(end, mf->size);
+	mf->faulted = MAX(mf->faulted, head);
+	// a few steps at a time, mapping the next chunk comes first
+	while ((mf->faulted < end) && (steps < 8)) {
+		size_t ofs = mf->ring ? mf->faulted % mf->size : mf->faulted;
+		size_t c = ofs / mf->chunk;
+		size_t len = MIN(end - mf->faulted, c * mf->chunk + chunk_len(mf, c) - ofs);
+		struct view *v = find_view(mf, c);
+		if (!v)
+			break;
+		len = MIN(len, PREFAULT_STEP);
+		if (mf->faulted < mf->size)
+			fallocate(mf->fd, FALLOC_FL_KEEP_SIZE, ofs, len);   // best effort
+		populate(mf, v->base + ofs - c * mf->chunk, len);
+		mf->faulted += len;
+		steps++;
+	}
+	return steps > 0;
+}
+
+static void *mmap_helper(void *arg) {
+	struct mf *mf = arg;
+	size_t started = 0, clean = 0;
+	struct timespec ts = {.tv_nsec = WB_POLL_NS};
+
+	while (!atomic_load(&mf->stop)) {
+		int busy = mmap_views(mf);
+		if (sink_prefault)
+			busy |= mmap_prefault(mf);
+		if (!mf->window) {
+			if (!busy)
+				nanosleep(&ts, NULL);
+			continue;
+		}
+		size_t head = atomic_load(&mf->head);
+		// kick off writeback of each completed window
+		while (started + mf->window <= head) {
+			mmap_wb_range(mf, started, started + mf->window, SYNC_FILE_RANGE_WRITE, 0);
+			started += mf->window;
+			busy = 1;
+		}
+		// the window before the latest one has had time, wait for it and drop it
+		while (clean + mf->window < started) {
+			mmap_wb_range(mf, clean, clean + mf->window, SYNC_FILE_RANGE_WAIT_BEFORE |
+				SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER, 1);
+			clean += mf->window;
+			atomic_store(&mf->clean, clean);
+			busy = 1;
+		}
+		if (!busy)
+			nanosleep(&ts, NULL);
+	}
+	return NULL;
+}
+
+static int mmap_open(struct sink *s, const char *fn) {
+	struct mf *mf = calloc(1, sizeof(struct mf));
+	if (!mf)
+		return -1;
+
+	// File create + mmap
+	int fd = open_excl(fn, 0);
+	if (fd < 0) {
+		free(mf);
+		return fd;
+	}
+	mf->size = s->size;
+	struct statfs sfs;
+	if (!fstatfs(fd, &sfs) && (sfs.f_type == HUGETLBFS_MAGIC)) {
+		// hugetlbfs only maps and truncates whole pages, and is RAM: nothing to write back
+		mf->huge = sfs.f_bsize;
+		mf->size = (s->size + mf->huge - 1) & ~(mf->huge - 1);
+		fprintf(stderr, "%s: hugetlbfs, %zu kB pages\n", fn, mf->huge >> 10);
+		if (s->ring)
+			s->size = mf->size;
+	}
+	else if (sink_hugepages && !fstatfs(fd, &sfs) && (sfs.f_type == TMPFS_MAGIC)) {
+		mf->thp = 1;
+		fprintf(stderr, "%s: tmpfs, transparent hugepages requested (mount with huge=within_size or advise)\n", fn);
+	}
+	if (ftruncate(fd, mf->size) != 0) {
+		perror("ftruncate");
+		goto fail;
+	}
+	mf->fd = fd;
+	mf->ring = s->ring;
+	mf->chunk = (mf->size > 2 * MAP_CHUNK) ? MAP_CHUNK : mf->size;
+	mf->nchunks = (mf->size + mf->chunk - 1) / mf->chunk;
+	for (int i = 0; i < MAP_VIEWS; i++)
+		mf->view[i].chunk = NO_CHUNK;
+	if (!(mf->cur = map_chunk(mf, 0)))
+		goto fail;
+	mf->view[0].chunk = 0;
+	mf->view[0].base = mf->cur;
+	atomic_init(&mf->next_chunk, NO_CHUNK);
+	mf->populate = 1;
+	s->fd = fd;
+	s->priv = mf;
+	if (sink_dirty_max && !mf->huge)
+		mf->window = MAX(sink_dirty_max / 4, (size_t)4096) & ~(size_t)4095;
+	if ((mf->nchunks > 1) || mf->window || sink_prefault) {
+		mf->helper_running = !pthread_create(&mf->helper, NULL, mmap_helper, mf);
+		if (!mf->helper_running) {
+			perror("pthread_create");
+			munmap(mf->cur, chunk_len(mf, 0));
+			goto fail;
+		}
+	}
+	return 0;
+fail:
+	close(fd);
+	free(mf);
+	return -1;
+}
+
+static void stall_wait(struct sink *s, struct timeval *t0) {
+	struct timeval t1;
+	gettimeofday(&t1, NULL);
+	s->stall_us += (t1.tv_sec - t0->tv_sec) * 1000000ULL + (t1.tv_usec - t0->tv_usec);
+}
+
+static int mmap_get(struct sink *s, void **dst, size_t *len) {
+	struct mf *mf = s->priv;
+	struct timespec ts = {.tv_nsec = WB_POLL_NS / 4};
+	struct timeval t0;
+	size_t pos = sink_pos(s), c = pos / mf->chunk;
+
+	if (mf->window) {
+		size_t dirty = s->written - atomic_load(&mf->clean);
+		if (dirty >= sink_dirty_max) {
+			gettimeofday(&t0, NULL);
+			while ((dirty = s->written - atomic_load(&mf->clean)) >= sink_dirty_max)
+				nanosleep(&ts, NULL);
+			stall_wait(s, &t0);
+		}
+		*len = MIN(*len, sink_dirty_max - dirty);
+	}
+	if (c != mf->cur_chunk) {
+		// normally mapped long ago
+		if (atomic_load_explicit(&mf->next_chunk, memory_order_acquire) != c) {
+			gettimeofday(&t0, NULL);
+			while (atomic_load_explicit(&mf->next_chunk, memory_order_acquire) != c) {
+				if (atomic_load(&mf->failed))
+					return -1;
+				nanosleep(&ts, NULL);
+			}
+			stall_wait(s, &t0);
+		}
+		mf->cur = mf->next;
+		mf->cur_chunk = c;
+		atomic_store(&mf->rx_chunk, c);
+	}
+	*len = MIN(*len, sink_space(s));
+	*len = MIN(*len, c * mf->chunk + chunk_len(mf, c) - pos);
+	*dst = mf->cur + pos - c * mf->chunk;
+	return 0;
+}
+
+static int mmap_put(struct sink *s, size_t len) {
+	struct mf *mf = s->priv;
+	s->written += len;
+	atomic_store_explicit(&mf->head, s->written, memory_order_release);
+	return 0;
+}
+
+static void mmap_close(struct sink *s) {
+	struct mf *mf = s->priv;
+	assert(s->fd >= 0);
+	if (mf->helper_running) {
+		atomic_store(&mf->stop, 1);
+		pthread_join(mf->helper, NULL);
+	}
+	for (int i = 0; i < MAP_VIEWS; i++) {
+		if (mf->view[i].chunk != NO_CHUNK)
+			munmap(mf->view[i].base, chunk_len(mf, mf->view[i].chunk));
+	}
+	// Truncate file to actual written data, only what wasn't written back is still dirty
+	size_t used = sink_used(s);
+	if (mf->huge && (used & (mf->huge - 1))) {
+		used = (used + mf->huge - 1) & ~(mf->huge - 1);
+		fprintf(stderr, "hugetlbfs: file padded to %zu bytes, %zu are samples\n", used, sink_used(s));
+	}
+	if (ftruncate(s->fd, used) != 0)
+		perror("ftruncate (final)");
+	if (s->written && (fdatasync(s->fd) != 0))
+		perror("fdatasync");
+	close(s->fd);
+	free(mf);
+}
+
+static const struct sink_ops mmap_ops = {
+	.name  = "mmap",
+	.open  = mmap_open,
+	.get   = mmap_get,
+	.put   = mmap_put,
+	.close = mmap_close,
+};
+
+/* ------------------------------------------------------------ io_uring --- */
+
+/*
+ * O_DIRECT needs buffer address, file offset and length aligned to the
+ * logical block size. Blocks handed to put() may end unaligned (short reads,
+ * last block), so the unaligned tail is carried over to the front of the
+ * next buffer and only whole DIO_ALIGN units are ever submitted.
+ */
+#define DIO_ALIGN       4096
+#define URING_DEPTH     16                 // writes in flight
+#define URING_BUF_SIZE  ((1 << 20) + DIO_ALIGN)
+
+struct uring {
+	struct io_uring ring;
+	uint8_t *bufs;              // URING_DEPTH * URING_BUF_SIZE
+	size_t bufs_size;           // as mapped
+	int fixed;                  // buffers registered with the ring
+	int free[URING_DEPTH];
+	int nfree;
+	int inflight;
+	int cur;                    // buffer handed out by get()
+	size_t carry;               // unaligned tail waiting in bufs[cur]
+	size_t offset;              // file offset of next submission
+	struct {
+		uintptr_t tag;
+		size_t len;
+	} req[URING_DEPTH];         // writes in flight, user_data is the slot
+	int req_free[URING_DEPTH];
+	int nreq_free;
+};
+
+/* completion tags: own buffers as idx << 1, sink_write() tags with bit 0 set */
+#define TAG_OWN(idx)    ((uintptr_t)(idx) << 1)
+#define TAG_EXT(tag)    ((uintptr_t)(tag) | 1)
+
+static uint8_t *uring_buf(struct uring *u, int idx) {
+	return u->bufs + (size_t)idx * URING_BUF_SIZE;
+}
+
+static int uring_reap(struct sink *s, int wait) {
+	struct uring *u = s->priv;
+	struct io_uring_cqe *cqe;
+	struct timeval t0, t1;
+	int res;
+
+	if (wait)
+		gettimeofday(&t0, NULL);
+	res = wait ? io_uring_wait_cqe(&u->ring, &cqe) : io_uring_peek_cqe(&u->ring, &cqe);
+	if (res == -EAGAIN)
+		return 0;
+	if (res < 0) {
+		fprintf(stderr, "io_uring_wait_cqe: %s\n", strerror(-res));
+		return res;
+	}
+	if (wait) {
+		gettimeofday(&t1, NULL);
+		s->stall_us += (t1.tv_sec - t0.tv_sec) * 1000000ULL + (t1.tv_usec - t0.tv_usec);
+	}
+	int slot = (int)(uintptr_t)io_uring_cqe_get_data(cqe);
+	uintptr_t tag = u->req[slot].tag;
+	size_t len = u->req[slot].len;
+	res = cqe->res;
+	io_uring_cqe_seen(&u->ring, cqe);
+	u->req_free[u->nreq_free++] = slot;
+	u->inflight--;
+	if (tag & 1)
+		s->release(s->release_ctx, (void *)(tag & ~(uintptr_t)1));
+	else
+		u->free[u->nfree++] = tag >> 1;
+	if (res < 0) {
+		fprintf(stderr, "io_uring write: %s\n", strerror(-res));
+		return res;
+	}
+	if ((size_t)res < len) {
+		// the rest of the block would be a hole of stale data in the file
+		fprintf(stderr, "io_uring write: short write (%d of %zu bytes)\n", res, len);
+		return -EIO;
+	}
+	return 1;
+}
+
+static int uring_submit(struct sink *s, void *data, size_t len, int fixed_idx, uintptr_t tag) {
+	struct uring *u = s->priv;
+	struct io_uring_sqe *sqe;
+	int res;
+
+	while (u->inflight >= URING_DEPTH) {
+		if ((res = uring_reap(s, 1)) < 0)
+			return res;
+	}
+	sqe = io_uring_get_sqe(&u->ring);
+	assert(sqe && u->nreq_free);
+	if (fixed_idx >= 0)
+		io_uring_prep_write_fixed(sqe, s->fd, data, len, u->offset, fixed_idx);
+	else
+		io_uring_prep_write(sqe, s->fd, data, len, u->offset);
+	int slot = u->req_free[--u->nreq_free];
+	u->req[slot].tag = tag;
+	u->req[slot].len = len;
+	io_uring_sqe_set_data(sqe, (void *)(uintptr_t)slot);
+	res = io_uring_submit(&u->ring);
+	if (res < 0) {
+		u->req_free[u->nreq_free++] = slot;
+		fprintf(stderr, "io_uring_submit: %s\n", strerror(-res));
+		return res;
+	}
+	u->inflight++;
+	u->offset += len;
+	if (s->ring && (u->offset == s->size))
+		u->offset = 0;
+	return 0;
+}
+
+static int uring_submit_own(struct sink *s, int idx, size_t len) {
+	struct uring *u = s->priv;
+	return uring_submit(s, uring_buf(u, idx), len, u->fixed ? idx : -1, TAG_OWN(idx));
+}
+
+static int uring_open(struct sink *s, const char *fn) {
+	struct uring *u = calloc(1, sizeof(struct uring));
+	size_t pool = (size_t)URING_DEPTH * URING_BUF_SIZE;
+	int res, fd;
+
+	if (!u)
+		return -1;
+	fd = open_excl(fn, O_DIRECT);
+	if (fd < 0) {
+		free(u);
+		return fd;
+	}
+	// preallocate so the writes don't extend the file, sparse if unsupported
+	if (fallocate(fd, 0, 0, s->size) != 0 && ftruncate(fd, s->size) != 0) {
+		perror("ftruncate");
+		goto fail;
+	}
+	if (!(u->bufs = buf_alloc(&pool, "io buffers")))
+		goto fail;
+	u->bufs_size = pool;
+	if ((res = io_uring_queue_init(URING_DEPTH, &u->ring, 0)) < 0) {
+		fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-res));
+		buf_free(u->bufs, pool);
+		goto fail;
+	}
+
+	// pin the buffers so the kernel can DMA from them without per-write mapping
+	struct iovec iov[URING_DEPTH];
+	for (int i = 0; i < URING_DEPTH; i++) {
+		iov[i].iov_base = uring_buf(u, i);
+		iov[i].iov_len  = URING_BUF_SIZE;
+		u->free[u->nfree++] = URING_DEPTH - 1 - i;
+		u->req_free[u->nreq_free++] = i;
+	}
+	res = io_uring_register_buffers(&u->ring, iov, URING_DEPTH);
+	u->fixed = (res == 0);
+	if (!u->fixed)
+		fprintf(stderr, "io_uring: buffers not pinned (%s), check RLIMIT_MEMLOCK\n", strerror(-res));
+
+	u->cur = -1;
+	s->fd = fd;
+	s->priv = u;
+	return 0;
+fail:
+	close(fd);
+	free(u);
+	return -1;
+}
+
+static int uring_get(struct sink *s, void **dst, size_t *len) {
+	struct uring *u = s->priv;
+	int res;
+
+	if (u->cur < 0) {
+		while (!u->nfree) {
+			if ((res = uring_reap(s, 1)) < 0)
+				return res;
+		}
+		u->cur = u->free[--u->nfree];
+	}
+	*len = MIN(*len, URING_BUF_SIZE - u->carry);
+	*len = MIN(*len, sink_space(s));
+	*dst = uring_buf(u, u->cur) + u->carry;
+	return 0;
+}
+
+static int uring_put(struct sink *s, size_t len) {
+	struct uring *u = s->priv;
+	size_t fill = u->carry + len;
+	size_t aligned = fill & ~(size_t)(DIO_ALIGN - 1);
+	int res;
+
+	assert(u->cur >= 0);
+	s->written += len;
+	if (!aligned) {
+		u->carry = fill;
+		return 0;
+	}
+	int idx = u->cur;
+	u->carry = fill - aligned;
+	u->cur = -1;
+	if (u->carry) {
+		// move the tail to the next buffer before this one goes in flight
+		while (!u->nfree) {
+			if ((res = uring_reap(s, 1)) < 0)
+				return res;
+		}
+		u->cur = u->free[--u->nfree];
+		memcpy(uring_buf(u, u->cur), uring_buf(u, idx) + aligned, u->carry);
+	}
+	if ((res = uring_submit_own(s, idx, aligned)) < 0)
+		return res;
+	// opportunistically recycle finished writes
+	while ((res = uring_reap(s, 0)) > 0);
+	return res;
+}
+
+size_t sink_in_place = 0;
+
+/*
+ * Aligned caller buffers are written in place. Anything else (unaligned
+ * memory, odd length, or a pending carry after a short block) is copied
+ * through the own buffers so the file stays contiguous.
+ */
+static int uring_write(struct sink *s, void *data, size_t len, void *tag) {
+	struct uring *u = s->priv;
+	int res;
+
+	if (u->carry || ((uintptr_t)data | len) & (DIO_ALIGN - 1) || (len > sink_space(s))) {
+		res = sink_copy(s, data, len);
+		s->release(s->release_ctx, tag);
+		return res;
+	}
+	if ((res = uring_submit(s, data, len, -1, TAG_EXT(tag))) < 0)
+		return res;
+	s->written += len;
+	sink_in_place++;
+	while ((res = uring_reap(s, 0)) > 0);
+	return res;
+}
+
+static int uring_flush(struct sink *s) {
+	struct uring *u = s->priv;
+	int res = 0;
+	while (u->inflight) {
+		if ((res = uring_reap(s, 1)) < 0)
+			break;
+	}
+	return res;
+}
+
+static void uring_close(struct sink *s) {
+	struct uring *u = s->priv;
+
+	uring_flush(s);
+	if (u->carry) {
+		// pad the tail to a full block, the file is truncated below anyway
+		size_t len = (u->carry + DIO_ALIGN - 1) & ~(size_t)(DIO_ALIGN - 1);
+		uint8_t *buf = uring_buf(u, u->cur), *old = uring_buf(u, u->free[0]);
+		memset(buf + u->carry, 0, len - u->carry);
+		// a wrapped ring keeps its oldest samples right behind the tail
+		if ((s->written > s->size) && (pread(s->fd, old, len, u->offset) == (ssize_t)len))
+			memcpy(buf + u->carry, old + u->carry, len - u->carry);
+		if (uring_submit_own(s, u->cur, len) == 0)
+			u->cur = -1;
+	}
+	if (u->cur >= 0)
+		u->free[u->nfree++] = u->cur;
+	uring_flush(s);
+	io_uring_queue_exit(&u->ring);
+	buf_free(u->bufs, u->bufs_size);
+
+	if (ftruncate(s->fd, sink_used(s)) != 0)
+		perror("ftruncate (final)");
+	if (fdatasync(s->fd) != 0)
+		perror("fdatasync");
+	close(s->fd);
+	free(u);
+}
+
+static const struct sink_ops uring_ops = {
+	.name  = "uring",
+	.open  = uring_open,
+	.get   = uring_get,
+	.put   = uring_put,
+	.write = uring_write,
+	.flush = uring_flush,
+	.close = uring_close,
+};
+
+/* ------------------------------------------------------------------------ */
+
+static const struct sink_ops *backends[] = {
+	[SINK_MMAP]  = &mmap_ops,
+	[SINK_URING] = &uring_ops,
+};
+
+int sink_parse_backend(const char *name) {
+	for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+		if (!strcmp(name, backends[i]->name))
+			return i;
+	}
+	return -1;
+}
+
+int sink_write(struct sink *s, void *data, size_t len, void *tag) {
+	if (s->ops->write)
+		return s->ops->write(s, data, len, tag);
+	int res = sink_copy(s, data, len);
+	s->release(s->release_ctx, tag);
+	return res;
+}
+
+int sink_open(struct sink *s, int backend, const char *fn, size_t max_size, int ring) {
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = backends[backend];
+	s->size = max_size;
+	s->ring = ring;
+	s->ss = sink_sample_size;
+	// a ring wraps on a block boundary so O_DIRECT writes never straddle it
+	if (ring)
+		s->size &= ~(size_t)(4096 - 1);
+	return s->ops->open(s, fn);
+}
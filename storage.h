@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A sink is the storage backend behind the capture file.
+ *
+ * The RX loop asks for a destination with sink_get(), lets libbladeRF
+ * receive into it and hands it back with sink_put(). The mmap backend
+ * returns a pointer into the file mapping, the io_uring backend one of
+ * its pinned, aligned buffers which is then written with O_DIRECT.
+ *
+ * Buffers owned by the caller (buffer pool, libbladeRF stream buffers) go
+ * through sink_write() instead. Backends that can write them in place do
+ * so and hand them back through the release callback once persisted, the
+ * others copy and release right away.
+ */
+
+enum sink_backend {
+	SINK_MMAP = 0,
+	SINK_URING,
+};
+
+struct sink;
+
+struct sink_ops {
+	const char *name;
+	int  (*open)(struct sink *s, const char *fn);
+	int  (*get)(struct sink *s, void **dst, size_t *len);
+	int  (*put)(struct sink *s, size_t len);
+	int  (*write)(struct sink *s, void *data, size_t len, void *tag);   // optional
+	int  (*flush)(struct sink *s);                                      // optional
+	void (*close)(struct sink *s);
+};
+
+struct sink {
+	const struct sink_ops *ops;
+	int fd;
+	size_t size;     // capacity in bytes
+	size_t written;  // bytes committed so far
+	int ring;        // wrap around at size instead of filling up
+	size_t ss;       // bytes per sample as stored
+	uint64_t mark_ts;  // device timestamp of the sample at mark_pos
+	size_t mark_pos;
+	uint64_t stall_us; // time the caller spent blocked on storage
+	void *priv;      // backend state
+	void (*release)(void *ctx, void *tag);  // sink_write() buffer may be reused
+	void *release_ctx;
+};
+
+/* bytes per IQ sample of the stream, default for sink.ss */
+extern size_t sink_sample_size;
+
+/* sink_write() buffers the io_uring backend wrote in place, all others are copied */
+extern size_t sink_in_place;
+
+/* mmap backend: bound on dirty page cache per file, 0 leaves it to the kernel */
+extern size_t sink_dirty_max;
+/* mmap backend: fault in this many bytes ahead of the write position, 0: off */
+extern size_t sink_prefault;
+
+/* back sample memory and tmpfs mappings with hugepages where possible */
+extern int sink_hugepages;
+void *buf_alloc(size_t *size, const char *what);
+void buf_free(void *p, size_t size);
+
+int sink_parse_backend(const char *name);
+int sink_open(struct sink *s, int backend, const char *fn, size_t max_size, int ring);
+
+/* fn is a printf pattern, a new file is started every seg_size bytes */
+int sink_open_segmented(struct sink *s, int backend, const char *pattern, size_t max_size, size_t seg_size);
+void segment_basename(char *dst, size_t len, const char *pattern);
+
+/* SC16 in, packed12 into inner (which is closed along with s) */
+int sink_open_packed(struct sink *s, struct sink *inner);
+
+/* iqz container into inner (see iqz.h), max_size counts uncompressed bytes */
+struct codec;
+int sink_open_compressed(struct sink *s, struct sink *inner, size_t max_size,
+	const struct codec *codec, int level, int nthreads);
+/* bytes taken in / stored in the container so far, for stats */
+void sink_compress_stats(struct sink *s, size_t *raw, size_t *stored);
+
+/* captured samples through a DDC (see ddc.h), its SC16 output into inner */
+struct ddc;
+int sink_open_downconv(struct sink *s, struct sink *inner, const struct ddc *ddc, int nthreads);
+/* the same through a rational resampler (see resamp.h) */
+struct resamp;
+int sink_open_resample(struct sink *s, struct sink *inner, const struct resamp *rs, int nthreads);
+
+/* captured samples through a PFB channelizer (see pfb.h), a file per channel */
+struct pfb;
+int sink_open_channels(struct sink *s, int backend, const char *pattern, size_t max_size,
+	const struct pfb *pfb, int nthreads, size_t *stored);
+/* the same for an overlap-save channel list (see ols.h) */
+struct ols;
+int sink_open_extract(struct sink *s, int backend, const char *pattern, size_t max_size,
+	const struct ols *ols, int nthreads, size_t *stored);
+
+/* only bursts above dbfs (closing hyst dB lower) with pre / post samples
+ * around them into inner, what's left out is listed in <base>.squelch */
+int sink_open_squelch(struct sink *s, struct sink *inner, size_t max_size, const char *base,
+	float dbfs, float hyst, size_t pre, size_t post);
+/* samples left out and bursts so far, for stats */
+void sink_squelch_stats(struct sink *s, uint64_t *dropped, size_t *bursts);
+
+/* the last size bytes in RAM, every time trig fires they go to a new file from the
+ * pattern with post bytes after it, listed in <basename>.events; trig is rearmed.
+ * *events, *stored: dumps and bytes written, set on close */
+struct trigger;
+int sink_open_memring(struct sink *s, int backend, const char *pattern, size_t size,
+	struct trigger *trig, size_t post, unsigned *events, size_t *stored);
+/* dumps so far and whether one is being written, for stats */
+void sink_memring_stats(struct sink *s, unsigned *events, int *dumping);
+
+/* blocks of the stream go round-robin to the n files, one writer thread each */
+#define STRIPE_MAX  8
+int sink_open_striped(struct sink *s, int backend, const char **fn, int n, size_t max_size);
+
+/* the next byte written belongs to the sample taken at device time ts */
+static inline void sink_mark(struct sink *s, uint64_t ts) {
+	s->mark_ts = ts;
+	s->mark_pos = s->written;
+}
+
+/* device timestamp of the next byte written */
+static inline uint64_t sink_ts(const struct sink *s) {
+	return s->mark_ts + (s->written - s->mark_pos) / s->ss;
+}
+
+/* file offset of the write position */
+static inline size_t sink_pos(const struct sink *s) {
+	return s->ring ? s->written % s->size : s->written;
+}
+
+/* contiguous bytes until the sink is full or wraps */
+static inline size_t sink_space(const struct sink *s) {
+	return s->size - sink_pos(s);
+}
+
+/* bytes of valid data in the file */
+static inline size_t sink_used(const struct sink *s) {
+	return (s->written < s->size) ? s->written : s->size;
+}
+
+/* *len: in = wanted bytes, out = usable bytes (0 once the sink is full) */
+static inline int sink_get(struct sink *s, void **dst, size_t *len) {
+	return s->ops->get(s, dst, len);
+}
+
+static inline int sink_put(struct sink *s, size_t len) {
+	return s->ops->put(s, len);
+}
+
+int sink_write(struct sink *s, void *data, size_t len, void *tag);
+int sink_copy(struct sink *s, const void *data, size_t len);
+int sink_zero(struct sink *s, size_t len);
+
+/* waits until all sink_write() buffers have been released */
+static inline int sink_flush(struct sink *s) {
+	return s->ops->flush ? s->ops->flush(s) : 0;
+}
+
+static inline void sink_close(struct sink *s) {
+	s->ops->close(s);
+}
+
+FILE *sidecar_open(const char *base, const char *ext);
+
+#endif
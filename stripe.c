@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Striped sink: RAID-0 in user space. The stream is cut into STRIPE_BLOCK
+ * sized blocks, block k goes to file k % n at offset (k / n) * STRIPE_BLOCK.
+ * Every file has its own inner sink and writer thread, fed through a pair
+ * of SPSC queues (full blocks in, written blocks back), so one slow disk
+ * only stalls the capture once its own queue is full. The layout is
+ * described in <first file>.stripe.
+ */
+
+#define _GNU_SOURCE
+#include <sys/time.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "storage.h"
+#include "pipeline.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define STRIPE_BLOCK    (1 << 20)   // bytes, multiple of the O_DIRECT alignment
+#define STRIPE_DEPTH    8           // blocks queued per disk
+#define POLL_NS         200000
+
+struct sblk {
+	uint8_t *data;
+	size_t len;
+};
+
+struct sdev {
+	struct stripe *st;
+	struct sink sink;
+	int open;
+	struct spsc free, full;
+	struct sblk blk[STRIPE_DEPTH];
+	pthread_t thread;
+	int running;
+};
+
+struct stripe {
+	int n;
+	int backend;
+	struct sdev dev[STRIPE_MAX];
+	uint8_t *mem;
+	size_t mem_size;
+	struct sblk *cur;          // block being filled
+	struct sdev *cur_dev;
+	size_t nblk;               // blocks started
+	_Atomic int stop;
+	_Atomic int failed;
+	const char *fn[STRIPE_MAX];
+};
+
+static void idle(void) {
+	struct timespec ts = {.tv_nsec = POLL_NS};
+	nanosleep(&ts, NULL);
+}
+
+/* inner sink is done with a block, on the disk thread */
+static void stripe_release(void *ctx, void *tag) {
+	struct sdev *d = ctx;
+	spsc_push(&d->free, tag);
+}
+
+static void *stripe_thread(void *arg) {
+	struct sdev *d = arg;
+	struct stripe *st = d->st;
+
+	for (;;) {
+		struct sblk *b = spsc_pop(&d->full);
+		if (!b) {
+			if (atomic_load(&st->stop) && !spsc_fill(&d->full))
+				break;
+			idle();
+			continue;
+		}
+		if (sink_write(&d->sink, b->data, b->len, b)) {
+			atomic_store(&st->failed, 1);
+			break;
+		}
+	}
+	sink_flush(&d->sink);
+	return NULL;
+}
+
+static void stripe_push(struct stripe *st) {
+	// can't fail: the queue holds all blocks of this disk
+	spsc_push(&st->cur_dev->full, st->cur);
+	st->cur = NULL;
+}
+
+static int stripe_get(struct sink *s, void **dst, size_t *len) {
+	struct stripe *st = s->priv;
+
+	*len = MIN(*len, s->size - s->written);
+	if (!*len)
+		return 0;
+	if (!st->cur) {
+		struct sdev *d = &st->dev[st->nblk % st->n];
+		struct timeval t0, t1;
+		if (!(st->cur = spsc_pop(&d->free))) {
+			gettimeofday(&t0, NULL);
+			while (!(st->cur = spsc_pop(&d->free))) {
+				if (atomic_load(&st->failed))
+					return -1;
+				idle();
+			}
+			gettimeofday(&t1, NULL);
+			s->stall_us += (t1.tv_sec - t0.tv_sec) * 1000000ULL + (t1.tv_usec - t0.tv_usec);
+		}
+		st->cur->len = 0;
+		st->cur_dev = d;
+		st->nblk++;
+	}
+	*len = MIN(*len, STRIPE_BLOCK - st->cur->len);
+	*dst = st->cur->data + st->cur->len;
+	return 0;
+}
+
+static int stripe_put(struct sink *s, size_t len) {
+	struct stripe *st = s->priv;
+	st->cur->len += len;
+	s->written += len;
+	if (st->cur->len == STRIPE_BLOCK)
+		stripe_push(st);
+	return atomic_load(&st->failed) ? -1 : 0;
+}
+
+static void stripe_layout(struct sink *s) {
+	struct stripe *st = s->priv;
+	FILE *fl = sidecar_open(st->fn[0], "stripe");
+	if (!fl)
+		return;
+	fprintf(fl, "# logical block k is block k / devices of file k %% devices\n");
+	fprintf(fl, "block %d\n", STRIPE_BLOCK);
+	fprintf(fl, "devices %d\n", st->n);
+	fprintf(fl, "size %zu\n", s->written);
+	for (int i = 0; i < st->n; i++)
+		fprintf(fl, "file %d %s\n", i, st->fn[i]);
+	fclose(fl);
+}
+
+static void stripe_close(struct sink *s) {
+	struct stripe *st = s->priv;
+
+	if (st->cur && st->cur->len)
+		stripe_push(st);
+	atomic_store(&st->stop, 1);
+	for (int i = 0; i < st->n; i++) {
+		struct sdev *d = &st->dev[i];
+		if (d->running)
+			pthread_join(d->thread, NULL);
+		if (d->open)
+			sink_close(&d->sink);
+		spsc_free(&d->free);
+		spsc_free(&d->full);
+	}
+	buf_free(st->mem, st->mem_size);
+	if (s->written)
+		stripe_layout(s);
+	free(st);
+}
+
+static int stripe_open(struct sink *s, const char *fn) {
+	struct stripe *st = s->priv;
+	size_t nblk = (s->size + STRIPE_BLOCK - 1) / STRIPE_BLOCK;
+	(void)fn;
+
+	st->mem_size = (size_t)st->n * STRIPE_DEPTH * STRIPE_BLOCK;
+	if (!(st->mem = buf_alloc(&st->mem_size, "stripe blocks")))
+		return -1;
+	for (int i = 0; i < st->n; i++) {
+		struct sdev *d = &st->dev[i];
+		// blocks i, i + n, i + 2n, ... of the stream
+		size_t size = (nblk - MIN(nblk, (size_t)i) + st->n - 1) / st->n * STRIPE_BLOCK;
+		d->st = st;
+		if (spsc_init(&d->free, STRIPE_DEPTH) || spsc_init(&d->full, STRIPE_DEPTH)) {
+			perror("stripe");
+			return -1;
+		}
+		for (int j = 0; j < STRIPE_DEPTH; j++) {
+			d->blk[j].data = st->mem + ((size_t)i * STRIPE_DEPTH + j) * STRIPE_BLOCK;
+			spsc_push(&d->free, &d->blk[j]);
+		}
+		if (!size)
+			continue;
+		if (sink_open(&d->sink, st->backend, st->fn[i], size, 0))
+			return -1;
+		d->open = 1;
+		d->sink.release = stripe_release;
+		d->sink.release_ctx = d;
+		if (pthread_create(&d->thread, NULL, stripe_thread, d)) {
+			perror("pthread_create");
+			return -1;
+		}
+		d->running = 1;
+	}
+	return 0;
+}
+
+static const struct sink_ops stripe_ops = {
+	.name  = "striped",
+	.open  = stripe_open,
+	.get   = stripe_get,
+	.put   = stripe_put,
+	.close = stripe_close,
+};
+
+int sink_open_striped(struct sink *s, int backend, const char **fn, int n, size_t max_size) {
+	struct stripe *st = calloc(1, sizeof(struct stripe));
+	if (!st)
+		return -1;
+	memset(s, 0, sizeof(struct sink));
+	s->fd = -1;
+	s->ops = &stripe_ops;
+	s->size = max_size;
+	s->ss = sink_sample_size;
+	s->priv = st;
+	st->n = n;
+	st->backend = backend;
+	memcpy(st->fn, fn, n * sizeof(char *));
+	if (stripe_open(s, fn[0])) {
+		stripe_close(s);
+		return -1;
+	}
+	return 0;
+}
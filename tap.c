@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "tap.h"
+
+#ifndef MIN
+#define MIN(a,b)    ((a)<=(b)?(a):(b))
+#endif
+
+#define POLL_NS     200000     // idle wait of the worker
+
+int tap_add(struct tap *t, tap_fn run, void *ctx) {
+	if (t->n == TAP_MAX)
+		return -1;
+	t->run[t->n] = run;
+	t->ctx[t->n++] = ctx;
+	return 0;
+}
+
+static void *tap_thread(void *arg) {
+	struct tap *t = arg;
+	struct timespec ts = {.tv_nsec = POLL_NS};
+
+	for (;;) {
+		struct buf *b = spsc_pop(&t->full);
+		if (!b) {
+			if (atomic_load(&t->stop) && !spsc_fill(&t->full))
+				break;
+			nanosleep(&ts, NULL);
+			continue;
+		}
+		for (int i = 0; i < t->n; i++) {
+			if (!t->failed[i] && t->run[i](t->ctx[i], b->data, b->len / t->ss, b->ts))
+				t->failed[i] = 1;
+		}
+		spsc_push(&t->free, b);
+	}
+	return NULL;
+}
+
+int tap_start(struct tap *t, size_t ss, size_t cap) {
+	t->ss = ss;
+	t->bufs = calloc(TAP_BUFS, sizeof(struct buf));
+	t->mem = malloc(TAP_BUFS * cap);
+	if (!t->bufs || !t->mem || spsc_init(&t->free, TAP_BUFS) || spsc_init(&t->full, TAP_BUFS)) {
+		perror("tap");
+		return -1;
+	}
+	for (int i = 0; i < TAP_BUFS; i++) {
+		t->bufs[i].data = (uint8_t *)t->mem + i * cap;
+		t->bufs[i].cap = cap;
+		spsc_push(&t->free, &t->bufs[i]);
+	}
+	if (pthread_create(&t->thread, NULL, tap_thread, t)) {
+		perror("pthread_create");
+		return -1;
+	}
+	t->running = 1;
+	return 0;
+}
+
+void tap_feed(struct tap *t, const void *iq, size_t n, uint64_t pos) {
+	const uint8_t *p = iq;
+
+	while (n) {
+		struct buf *b = spsc_pop(&t->free);
+		if (!b) {
+			atomic_fetch_add(&t->dropped, n);
+			return;
+		}
+		size_t k = MIN(n, b->cap / t->ss);
+		memcpy(b->data, p, k * t->ss);
+		b->len = k * t->ss;
+		b->ts = pos;
+		spsc_push(&t->full, b);
+		p += k * t->ss;
+		pos += k;
+		n -= k;
+	}
+}
+
+int tap_stop(struct tap *t) {
+	int res = 0;
+
+	if (t->running) {
+		atomic_store(&t->stop, 1);
+		pthread_join(t->thread, NULL);
+	}
+	spsc_free(&t->free);
+	spsc_free(&t->full);
+	free(t->bufs);
+	free(t->mem);
+	for (int i = 0; i < t->n; i++)
+		res |= t->failed[i];
+	t->running = 0;
+	return res ? -1 : 0;
+}
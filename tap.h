@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TAP_H
+#define TAP_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pipeline.h"
+
+/*
+ * Copies of the RX stream for analysis on a worker thread (spectrogram,
+ * activity index, magnitude pyramid), so none of it costs RX time beyond
+ * a memcpy. Feeding never blocks: when the worker is behind, samples are
+ * dropped and counted, and the consumers see pos jump.
+ */
+
+#define TAP_BUFS    32          // copies in flight to the worker
+#define TAP_MAX     4           // consumers
+
+typedef int (*tap_fn)(void *ctx, const void *iq, size_t n, uint64_t pos);
+
+struct tap {
+	size_t ss;
+	int n;
+	tap_fn run[TAP_MAX];
+	void *ctx[TAP_MAX];
+	int failed[TAP_MAX];        // gave an error, not called again
+
+	struct buf *bufs;
+	void *mem;
+	struct spsc free, full;
+	pthread_t thread;
+	int running;
+	_Atomic int stop;
+	_Atomic uint64_t dropped;   // samples not handed to the worker
+};
+
+/* run(ctx, iq, n, pos) gets n samples at stream sample pos, on the worker */
+int  tap_add(struct tap *t, tap_fn run, void *ctx);
+/* buffers of cap bytes */
+int  tap_start(struct tap *t, size_t ss, size_t cap);
+/* n samples at stream sample pos, copies them for the worker */
+void tap_feed(struct tap *t, const void *iq, size_t n, uint64_t pos);
+/* drains what was queued and joins the worker, -1 if a consumer failed */
+int  tap_stop(struct tap *t);
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "trigger.h"
+
+#define FULL_SCALE(ss)  (((ss) == 2) ? 128 : 2048)   // SC8 Q7, SC16 Q11
+
+static volatile sig_atomic_t usr1_flag = 0;
+
+static void handle_usr1(int sig) {
+	(void)sig;
+	usr1_flag = 1;
+}
+
+/* dbfs: mean power threshold relative to a full scale tone, NAN disables; ss: bytes per sample */
+int trigger_init(struct trigger *t, const char *fifo, float dbfs, size_t ss) {
+	memset(t, 0, sizeof(struct trigger));
+	t->fifo = -1;
+	t->dbfs = dbfs;
+	t->ss = ss;
+	if (!isnan(dbfs))
+		t->level = powf(10.0f, dbfs / 10.0f) * FULL_SCALE(ss) * FULL_SCALE(ss) * TRIGGER_WINDOW;
+
+	if (fifo) {
+		if (mkfifo(fifo, S_IRUSR | S_IWUSR) != 0 && errno != EEXIST) {
+			perror("mkfifo");
+			return -1;
+		}
+		// O_RDWR keeps the FIFO open even while no writer is attached
+		t->fifo = open(fifo, O_RDWR | O_NONBLOCK);
+		if (t->fifo < 0) {
+			perror("control fifo");
+			return -1;
+		}
+	}
+
+	struct sigaction sa;
+	sa.sa_handler = handle_usr1;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = 0;
+	sigaction(SIGUSR1, &sa, NULL);
+	return 0;
+}
+
+void trigger_close(struct trigger *t) {
+	if (t->fifo >= 0)
+		close(t->fifo);
+	t->fifo = -1;
+}
+
+/* first caller wins, power checks on the writer may race the main thread */
+void trigger_fire(struct trigger *t, uint64_t pos, const char *cause) {
+	int expected = 0;
+	if (!atomic_compare_exchange_strong(&t->claimed, &expected, 1))
+		return;
+	t->pos = pos;
+	t->cause = cause;
+	atomic_store_explicit(&t->fired, 1, memory_order_release);
+}
+
+void trigger_rearm(struct trigger *t) {
+	atomic_store(&t->fired, 0);
+	atomic_store(&t->claimed, 0);
+}
+
+/* signal and control FIFO; pos: current stream offset. Returns CTRL_* */
+int trigger_poll(struct trigger *t, uint64_t pos) {
+	int ret = CTRL_NONE;
+	char c;
+
+	if (usr1_flag) {
+		usr1_flag = 0;
+		trigger_fire(t, pos, "SIGUSR1");
+	}
+	while ((t->fifo >= 0) && (read(t->fifo, &c, 1) == 1)) {
+		if (c != '\n') {
+			if (t->line_len < sizeof(t->line) - 1)
+				t->line[t->line_len++] = c;
+			continue;
+		}
+		t->line[t->line_len] = 0;
+		t->line_len = 0;
+		if (!strcmp(t->line, "trigger"))
+			trigger_fire(t, pos, "command");
+		else if (!strcmp(t->line, "stop"))
+			ret = CTRL_STOP;
+		else
+			fprintf(stderr, "\nunknown control command: %s\n", t->line);
+	}
+	return ret;
+}
+
+/* fires on the first window over the threshold; pos: stream offset of iq */
+void trigger_power(struct trigger *t, const void *iq, size_t n, uint64_t pos) {
+	if (!t->level || atomic_load(&t->claimed))
+		return;
+	for (size_t ofs = 0; ofs + TRIGGER_WINDOW <= n; ofs += TRIGGER_WINDOW) {
+		int64_t acc = 0;
+		if (t->ss == 2) {
+			const int8_t *p = (const int8_t *)iq + ofs * 2;
+			for (size_t i = 0; i < TRIGGER_WINDOW * 2; i++)
+				acc += (int32_t)p[i] * p[i];
+		}
+		else {
+			const int16_t *p = (const int16_t *)iq + ofs * 2;
+			for (size_t i = 0; i < TRIGGER_WINDOW * 2; i++)
+				acc += (int32_t)p[i] * p[i];
+		}
+		if (acc > t->level) {
+			trigger_fire(t, pos + ofs * t->ss, "power");
+			return;
+		}
+	}
+}
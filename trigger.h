@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2025 Benedikt Heinz <Zn000h AT gmail.com>
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This code is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this code.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Capture trigger. Fires once until rearmed, on whichever comes first:
+ *  - SIGUSR1
+ *  - "trigger" written to the control FIFO ("stop" ends the capture)
+ *  - mean power of a TRIGGER_WINDOW sample window above the threshold
+ * pos is the stream byte offset at which it fired.
+ */
+
+#define TRIGGER_WINDOW  2048    // samples
+
+enum {
+	CTRL_NONE = 0,
+	CTRL_STOP,
+};
+
+struct trigger {
+	_Atomic int claimed;
+	_Atomic int fired;      // pos and cause are valid
+	uint64_t pos;
+	const char *cause;
+	float dbfs;
+	int64_t level;          // window energy threshold, 0: off
+	size_t ss;              // bytes per sample: 4 (SC16 Q11) or 2 (SC8 Q7)
+	int fifo;
+	char line[64];
+	size_t line_len;
+};
+
+int  trigger_init(struct trigger *t, const char *fifo, float dbfs, size_t ss);
+void trigger_close(struct trigger *t);
+void trigger_fire(struct trigger *t, uint64_t pos, const char *cause);
+int  trigger_poll(struct trigger *t, uint64_t pos);
+void trigger_power(struct trigger *t, const void *iq, size_t n, uint64_t pos);
+/* ready for the next event, once pos and cause have been dealt with */
+void trigger_rearm(struct trigger *t);
+
+static inline int trigger_fired(struct trigger *t) {
+	return atomic_load_explicit(&t->fired, memory_order_acquire);
+}
+
+#endif